@@ -55,24 +55,17 @@ function CanDamage(targ, inflictor)
         return true
     end
 
-    trace = traceline(inflictor.origin, targ.origin + vec3(15,15,0), MOVE_NOMONSTERS, self)
-    if trace.fraction == 1 then
-        return true
-    end
-
-    trace = traceline(inflictor.origin, targ.origin + vec3(-15,-15,0), MOVE_NOMONSTERS, self)
-    if trace.fraction == 1 then
-        return true
-    end
-
-    trace = traceline(inflictor.origin, targ.origin + vec3(-15,15,0), MOVE_NOMONSTERS, self)
-    if trace.fraction == 1 then
-        return true
-    end
-
-    trace = traceline(inflictor.origin, targ.origin + vec3(15,-15,0), MOVE_NOMONSTERS, self)
-    if trace.fraction == 1 then
-        return true
+    -- the center is hidden, try the four corners in one call
+    local traces = tracelines(inflictor.origin, {
+        targ.origin + vec3(15,15,0),
+        targ.origin + vec3(-15,-15,0),
+        targ.origin + vec3(-15,15,0),
+        targ.origin + vec3(15,-15,0)
+    }, MOVE_NOMONSTERS, self)
+    for i = 1, 4 do
+        if traces[i].fraction == 1 then
+            return true
+        end
     end
 
     return false
@@ -254,8 +247,11 @@ function T_RadiusDamage(inflictor, attacker, damage, ignore, dtype)
     local points;
     local head;
     local org;
+    local list = findradius(inflictor.origin, damage+40, true)
 
-    for head in findradius(inflictor.origin, damage+40) do
+    -- removed entities stay in the list but no longer take damage
+    for i = 1, #list do
+        head = list[i]
         if head ~= ignore then
             if head.takedamage > 0 then
                 org = head.origin + (head.mins + head.maxs)*0.5
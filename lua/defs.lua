@@ -235,6 +235,11 @@ rj          = 1
 function find(start, field, value)
     local found_start = false
 
+    -- indexed by the engine
+    if field == "classname" or field == "targetname" then
+        return find_by(field, value, start)
+    end
+
     return entities(function(e)
         if not found_start then
             if e == start then
@@ -262,6 +262,10 @@ Used by shotgun, super shotgun, and enemy soldier firing
 Go to the trouble of combining multiple pellets into a single damage call.
 ================
 ]]
+local bullet_dirs = {}
+local bullet_ends = {}
+local bullet_traces = {}
+
 function FireBullets(shotcount, dir, spread)
     local direction
     local src
@@ -273,17 +277,26 @@ function FireBullets(shotcount, dir, spread)
 
     ClearMultiDamage ()
 
-    local trace = traceline (src, src + dir*2048, MOVE_NORMAL, self)
-    puff_org = trace.endpos - dir*4
-
-    while shotcount > 0 do
+    -- the first line is straight ahead for the puffs, then one per pellet
+    -- all traced in one call
+    bullet_ends[1] = src + dir*2048
+    for i = 1, shotcount do
         direction = dir + crandom()*spread.x*v_right + crandom()*spread.y*v_up
-        trace = traceline (src, src + direction*2048, MOVE_NORMAL, self)
+        bullet_dirs[i] = direction
+        bullet_ends[i + 1] = src + direction*2048
+    end
+    for i = shotcount + 2, #bullet_ends do
+        bullet_ends[i] = nil
+    end
+
+    local traces = tracelines (src, bullet_ends, MOVE_NORMAL, self, bullet_traces)
+    puff_org = traces[1].endpos - dir*4
+
+    for i = 1, shotcount do
+        local trace = traces[i + 1]
         if trace.fraction ~= 1.0 then
-            TraceAttack (trace, 4, direction, v_up, v_right)
+            TraceAttack (trace, 4, bullet_dirs[i], v_up, v_right)
         end
-
-        shotcount = shotcount - 1
     end
 
     ApplyMultiDamage ()
@@ -474,13 +487,13 @@ function LightningDamage(p1, p2, from, damage)
     end
     e1 = trace.ent
 
-    trace = traceline (p1 + f, p2 + f, MOVE_NORMAL, self)
+    trace = traceline (p1 + f, p2 + f, MOVE_NORMAL, self, trace)
     if trace.ent and trace.ent ~= e1 and trace.ent.takedamage > 0 then
         LightningHit (trace, from, damage)
     end
     e2 = trace.ent
 
-    trace = traceline (p1 - f, p2 - f, MOVE_NORMAL, self)
+    trace = traceline (p1 - f, p2 - f, MOVE_NORMAL, self, trace)
     if trace.ent and trace.ent ~= e1 and trace.ent ~= e2 and trace.ent.takedamage > 0 then
         LightningHit (trace, from, damage)
     end
@@ -0,0 +1,333 @@
+// lua_alloc.c -- Lua heap
+
+/*
+   the Lua state allocates from the C library unless -luamem <kb> is
+   given, then it gets a zone of its own set aside on the hunk at startup
+   and the game can never take more than that.  the hunk has to be made
+   big enough for it with -mem.
+
+   blocks up to POOL_MAX bytes are rounded up to a size class and recycled
+   through per class free lists, carved out of slabs taken from the zone.
+   vec3_t userdata, edict field tables and short strings all land there.
+   larger blocks go straight to the zone.
+*/
+
+#include "qwsvdef.h"
+
+extern lua_State *L;
+
+#define POOL_GRAIN      16
+#define POOL_MAX        256
+#define POOL_CLASSES    (POOL_MAX / POOL_GRAIN)
+#define POOL_SLAB       (16 * 1024)
+
+#define POOL_CLASS(s)   (((s) + POOL_GRAIN - 1) / POOL_GRAIN - 1)
+
+typedef struct poolblock_s {
+    struct poolblock_s *next;
+} poolblock_t;
+
+typedef struct {
+    int live;                   // blocks held by Lua
+    int livebytes;
+    int peakbytes;
+    int slabs;
+    int zonefails;              // allocations the zone could not satisfy
+    int classlive[POOL_CLASSES];
+} prmemstats_t;
+
+static memzone_t *pr_memzone;
+static int pr_memsize;
+
+static poolblock_t *pr_pool[POOL_CLASSES];
+static byte *pr_slab;
+static int pr_slableft;
+
+static prmemstats_t pr_memstats;
+
+static void PR_PoolFree(void *ptr, size_t size)
+{
+    poolblock_t *b;
+    int c;
+
+    if (size > POOL_MAX) {
+        Z_FreeZone(pr_memzone, ptr);
+        return;
+    }
+
+    c = POOL_CLASS(size);
+    b = ptr;
+    b->next = pr_pool[c];
+    pr_pool[c] = b;
+    pr_memstats.classlive[c]--;
+}
+
+static void *PR_PoolAlloc(size_t size)
+{
+    poolblock_t *b;
+    int c, bytes;
+
+    if (size > POOL_MAX) {
+        b = Z_TagMallocZone(pr_memzone, size, 1);
+        if (!b)
+            pr_memstats.zonefails++;
+        return b;
+    }
+
+    c = POOL_CLASS(size);
+    bytes = (c + 1) * POOL_GRAIN;
+
+    if ((b = pr_pool[c])) {
+        pr_pool[c] = b->next;
+        pr_memstats.classlive[c]++;
+        return b;
+    }
+
+    if (pr_slableft < bytes) {
+        b = Z_TagMallocZone(pr_memzone, POOL_SLAB, 2);
+        if (!b) {
+            pr_memstats.zonefails++;
+            return NULL;
+        }
+
+        // the tail of the old slab still fits a smaller class
+        if (pr_slableft) {
+            pr_memstats.classlive[POOL_CLASS(pr_slableft)]++;
+            PR_PoolFree(pr_slab, pr_slableft);
+        }
+
+        pr_slab = (byte *)b;
+        pr_slableft = POOL_SLAB;
+        pr_memstats.slabs++;
+    }
+
+    b = (poolblock_t *)pr_slab;
+    pr_slab += bytes;
+    pr_slableft -= bytes;
+    pr_memstats.classlive[c]++;
+
+    return b;
+}
+
+// true if a block of osize can hold nsize as it is
+static qboolean PR_PoolFits(size_t osize, size_t nsize)
+{
+    if (osize <= POOL_MAX && nsize <= POOL_MAX)
+        return POOL_CLASS(osize) == POOL_CLASS(nsize);
+
+    // zone blocks know their own size, they can shrink in place
+    return osize > POOL_MAX && nsize > POOL_MAX && nsize <= osize;
+}
+
+/*
+=================
+PR_Alloc
+
+lua_Alloc for the game state
+=================
+*/
+void *PR_Alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+    void *n;
+
+    if (!ptr)
+        osize = 0;              // osize is the object type then
+
+    if (nsize == 0) {
+        if (ptr) {
+            if (pr_memzone)
+                PR_PoolFree(ptr, osize);
+            else
+                free(ptr);
+            pr_memstats.live--;
+            pr_memstats.livebytes -= osize;
+        }
+        return NULL;
+    }
+
+    if (!pr_memzone) {
+        n = realloc(ptr, nsize);
+    } else if (ptr && PR_PoolFits(osize, nsize)) {
+        n = ptr;
+    } else {
+        n = PR_PoolAlloc(nsize);
+
+        // Lua expects shrinking to always work
+        if (!n && ptr && nsize <= osize)
+            n = ptr;
+
+        if (n && ptr && n != ptr) {
+            memcpy(n, ptr, osize < nsize ? osize : nsize);
+            PR_PoolFree(ptr, osize);
+        }
+    }
+
+    if (!n)
+        return NULL;
+
+    if (!ptr)
+        pr_memstats.live++;
+    if (n != ptr) {
+        svs.stats.luaallocs++;
+        svs.stats.luabytes += nsize;
+    }
+
+    pr_memstats.livebytes += nsize - osize;
+    if (pr_memstats.livebytes > pr_memstats.peakbytes)
+        pr_memstats.peakbytes = pr_memstats.livebytes;
+
+    return n;
+}
+
+/*
+==============================================================================
+
+GARBAGE COLLECTION
+
+With a budget set the collector is stopped and only stepped from SV_Frame
+once the client messages are out, so a collection never lands in the
+middle of physics or a client move.  A new cycle only starts when the heap
+has doubled since the last one ended, like the collector's own pause.
+
+If the game allocates faster than the budget lets the steps keep up, the
+heap would grow without bound, so a cycle that doubles the heap again or
+runs for GC_MAXFRAMES frames is finished at once whatever it costs.
+
+==============================================================================
+*/
+
+#define GC_MAXFRAMES    100
+
+static qboolean pr_gcstepped;
+static int pr_gcpausekb;        // start the next cycle past this size
+static int pr_gclimitkb;        // finish the cycle at once past this size
+static int pr_gcframes;         // frames the cycle has been stepped for
+static int pr_gcforced;         // cycles finished past the budget
+
+/*
+=================
+PR_StepGC
+
+budget is in seconds, 0 hands collection back to Lua
+=================
+*/
+void PR_StepGC(double budget)
+{
+    double start;
+    qboolean finished;
+    int kb;
+
+    if (!L)
+        return;
+
+    if (budget <= 0) {
+        if (pr_gcstepped) {
+            lua_gc(L, LUA_GCRESTART, 0);
+            pr_gcstepped = false;
+        }
+        return;
+    }
+
+    if (!pr_gcstepped) {
+        lua_gc(L, LUA_GCSTOP, 0);
+        pr_gcstepped = true;
+        pr_gcpausekb = 0;
+        pr_gcframes = 0;
+    }
+
+    kb = lua_gc(L, LUA_GCCOUNT, 0);
+    if (kb < pr_gcpausekb)
+        return;
+
+    if (!pr_gcframes)
+        pr_gclimitkb = kb * 2;
+
+    start = Sys_DoubleTime();
+    finished = false;
+
+    if (kb > pr_gclimitkb || ++pr_gcframes > GC_MAXFRAMES) {
+        // the steps are not keeping up with the game
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        pr_gcforced++;
+        finished = true;
+    } else {
+        do {
+            if (lua_gc(L, LUA_GCSTEP, 0)) {
+                finished = true;
+                break;
+            }
+        } while (Sys_DoubleTime() - start < budget);
+    }
+
+    if (finished) {
+        pr_gcpausekb = lua_gc(L, LUA_GCCOUNT, 0) * 2;
+        pr_gcframes = 0;
+    }
+
+    svs.stats.gc += Sys_DoubleTime() - start;
+}
+
+/*
+=================
+PR_Mem_f
+
+luamem
+=================
+*/
+static void PR_Mem_f(void)
+{
+    int i;
+
+    if (pr_memzone)
+        Con_Printf("heap      : %i KB zone\n", pr_memsize / 1024);
+    else
+        Con_Printf("heap      : C library\n");
+
+    Con_Printf("live      : %i blocks, %i KB\n", pr_memstats.live,
+               pr_memstats.livebytes / 1024);
+    Con_Printf("peak      : %i KB\n", pr_memstats.peakbytes / 1024);
+    Con_Printf("allocs    : %5.2f/frame, %5.2f KB/frame\n",
+               (float) svs.stats.latched_luaallocs / STATFRAMES,
+               (float) svs.stats.latched_luabytes / STATFRAMES / 1024);
+    if (pr_gcstepped)
+        Con_Printf("gc forced : %i cycles\n", pr_gcforced);
+
+    if (!pr_memzone)
+        return;
+
+    Con_Printf("slabs     : %i KB\n", pr_memstats.slabs * POOL_SLAB / 1024);
+    Con_Printf("zone fails: %i\n", pr_memstats.zonefails);
+
+    for (i = 0; i < POOL_CLASSES; i++)
+        if (pr_memstats.classlive[i])
+            Con_Printf("%4i bytes: %i live\n", (i + 1) * POOL_GRAIN,
+                       pr_memstats.classlive[i]);
+}
+
+/*
+=================
+PR_InitAlloc
+
+Has to run before host_hunklevel is set, the heap outlives levels
+=================
+*/
+void PR_InitAlloc(void)
+{
+    int p;
+
+    pr_memsize = 0;
+
+    p = COM_CheckParm("-luamem");
+    if (p) {
+        if (p < com_argc - 1)
+            pr_memsize = Q_atoi(com_argv[p + 1]) * 1024;
+        else
+            Sys_Error
+                ("PR_InitAlloc: you must specify a size in KB after -luamem");
+    }
+
+    if (pr_memsize > 0)
+        pr_memzone = Z_NewZone(pr_memsize, "luamem");
+
+    Cmd_AddCommand("luamem", PR_Mem_f);
+}
@@ -119,6 +119,7 @@ int PF_setorigin(lua_State *L)
     e = luaL_checkudata(L, 1, "edict_t");
     org = PR_Vec3_ToVec(L, 2);
     VectorCopy(org, (*e)->v.origin);
+    SV_MarkNetDirty(*e, ND_ORIGIN);
     SV_LinkEdict(*e, false);
     return 0;
 }
@@ -181,10 +182,9 @@ int PF_setmodel(lua_State *L)
     if (!*check)
         PR_RunError("no precache: %s\n", m);
 
-    if ((*e)->v.model)
-        luaL_unref(L, LUA_REGISTRYINDEX, (*e)->v.model);
-    (*e)->v.model = PR_SetString(m);
+    PR_ReplaceString(&(*e)->v.model, m);
     (*e)->v.modelindex = i;
+    SV_MarkNetDirty(*e, ND_MODEL);
 
     // if it is an inline model, get the size information for it
     if (m[0] == '*') {
@@ -504,13 +504,16 @@ Used for use tracing and shot targeting
 Traces are blocked by bbox and exact bsp entityes, and also slide box entities
 if the tryents flag is set.
 
-traceline (vector1, vector2, type)
+An existing result can be passed in to be refilled instead of creating a
+new one.
+
+traceline (vector1, vector2, type, edict[, result])
 =================
 */
 int PF_traceline(lua_State *L)
 {
-    vec_t *v1, *v2, *tv;
-    trace_t trace;
+    vec_t *v1, *v2;
+    trace_t *trace;
     int type;
     edict_t **ent;
 
@@ -519,39 +522,79 @@ int PF_traceline(lua_State *L)
     type = luaL_checkinteger(L, 3);
     ent = luaL_checkudata(L, 4, "edict_t");
 
-    trace = SV_Move(v1, vec3_origin, vec3_origin, v2, type, *ent);
-
-    lua_newtable(L);
-    lua_pushboolean(L, trace.allsolid);
-    lua_setfield(L, -2, "allsolid");
-    lua_pushboolean(L, trace.startsolid);
-    lua_setfield(L, -2, "startsolid");
-    lua_pushboolean(L, trace.inopen);
-    lua_setfield(L, -2, "inopen");
-    lua_pushboolean(L, trace.inwater);
-    lua_setfield(L, -2, "inwater");
-    lua_pushnumber(L, trace.fraction);
-    lua_setfield(L, -2, "fraction");
-    tv = PR_Vec3_New(L);
-    VectorCopy(trace.endpos, tv);
-    lua_setfield(L, -2, "endpos");
-
-    if (trace.ent) {
-        ED_PushEdict(L, trace.ent);
-    } else {
-        lua_pushnil(L);
+    trace = PR_Trace_Push(L, 5);
+    *trace = SV_Move(v1, vec3_origin, vec3_origin, v2, type, *ent);
+
+    return 1;
+}
+
+/*
+=================
+PF_tracelines
+
+traceline for many lines at once, for shotgun blasts and line of sight
+checks.  starts is a table with a vector for each line, or one vector for
+all of them.  Returns a table with a trace_t for each line; an existing
+table can be passed in to have its traces refilled.
+
+tracelines (starts, ends, type, edict[, results])
+=================
+*/
+int PF_tracelines(lua_State *L)
+{
+    static vec3_t starts[MAX_MOVELINES], ends[MAX_MOVELINES];
+    static trace_t traces[MAX_MOVELINES];
+    vec_t **v, *start;
+    trace_t *trace;
+    int i, count, type;
+    edict_t **ent;
+
+    start = lua_istable(L, 1) ? NULL : PR_Vec3_ToVec(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    type = luaL_checkinteger(L, 3);
+    ent = luaL_checkudata(L, 4, "edict_t");
+
+    count = lua_rawlen(L, 2);
+    luaL_argcheck(L, count <= MAX_MOVELINES, 2, "too many lines");
+
+    for (i = 0; i < count; i++) {
+        if (start) {
+            VectorCopy(start, starts[i]);
+        } else {
+            lua_rawgeti(L, 1, i + 1);
+            v = luaL_testudata(L, -1, "vec3_t");
+            if (!v)
+                return luaL_error(L, "tracelines: start %d is not a vector",
+                                  i + 1);
+            VectorCopy(*v, starts[i]);
+            lua_pop(L, 1);
+        }
+
+        lua_rawgeti(L, 2, i + 1);
+        v = luaL_testudata(L, -1, "vec3_t");
+        if (!v)
+            return luaL_error(L, "tracelines: end %d is not a vector",
+                              i + 1);
+        VectorCopy(*v, ends[i]);
+        lua_pop(L, 1);
     }
 
-    lua_setfield(L, -2, "ent");
+    SV_MoveLines(count, starts, ends, type, *ent, traces);
+
+    if (lua_isnoneornil(L, 5)) {
+        lua_createtable(L, count, 0);
+    } else {
+        luaL_checktype(L, 5, LUA_TTABLE);
+        lua_pushvalue(L, 5);
+    }
 
-    // plane fields
-    lua_newtable(L);
-    tv = PR_Vec3_New(L);
-    VectorCopy(trace.plane.normal, tv);
-    lua_setfield(L, -2, "normal");
-    lua_pushnumber(L, trace.plane.dist);
-    lua_setfield(L, -2, "dist");
-    lua_setfield(L, -2, "plane");
+    for (i = 0; i < count; i++) {
+        lua_rawgeti(L, -1, i + 1);
+        trace = PR_Trace_Push(L, -1);
+        *trace = traces[i];
+        lua_rawseti(L, -3, i + 1);
+        lua_pop(L, 1);
+    }
 
     return 1;
 }
@@ -752,54 +795,89 @@ int PF_cvar_set(lua_State *L)
 
 static int findradius_iterator(lua_State *L)
 {
+    edict_t **e;
+    int i;
+
+    i = lua_tointeger(L, lua_upvalueindex(2));
+
+    // skip entities removed by the loop body
+    while (lua_rawgeti(L, lua_upvalueindex(1), i++) != LUA_TNIL) {
+        e = lua_touserdata(L, -1);
+        if (!(*e)->free) {
+            lua_pushinteger(L, i);
+            lua_replace(L, lua_upvalueindex(2));
+            return 1;
+        }
+        lua_pop(L, 1);
+    }
+
+    return 0;
+}
+
+static int findradius_compare(const void *a, const void *b)
+{
+    return *(edict_t **)a < *(edict_t **)b ? -1 : 1;
+}
+
+/*
+=================
+PF_findradius
+
+Returns the entities whose centers are within a spherical area, in edict
+order.  Only entities linked into the area tree are considered, which are
+all the non-SOLID_NOT entities other than the world.
+
+findradius (origin, radius[, asarray])
+=================
+*/
+int PF_findradius(lua_State *L)
+{
+    static edict_t *list[MAX_EDICTS];
     edict_t *ent;
     vec_t *org;
-    vec3_t eorg;
+    vec3_t mins, maxs, eorg;
     float rad;
-    int i, j;
+    int i, j, n, count;
 
-    org = PR_Vec3_ToVec(L, lua_upvalueindex(1));
-    rad = luaL_checknumber(L, lua_upvalueindex(2));
-    i = lua_tointeger(L, lua_upvalueindex(3));
+    org = PR_Vec3_ToVec(L, 1);
+    rad = luaL_checknumber(L, 2);
 
-    for (; i < sv.num_edicts; i++) {
-        ent = EDICT_NUM(i);
-        if (ent->free)
-            continue;
+    for (j = 0; j < 3; j++) {
+        mins[j] = org[j] - rad;
+        maxs[j] = org[j] + rad;
+    }
+
+    count = SV_AreaEdicts(mins, maxs, list, MAX_EDICTS);
+
+    // the center lies inside the abs box, so the box test never drops
+    // an entity the sphere test would keep
+    for (i = n = 0; i < count; i++) {
+        ent = list[i];
         if (ent->v.solid == SOLID_NOT)
             continue;
         for (j = 0; j < 3; j++)
             eorg[j] =
                 org[j] - (ent->v.origin[j] +
                           (ent->v.mins[j] + ent->v.maxs[j]) * 0.5);
-        if (Length(eorg) > rad)
+        if (DotProduct(eorg, eorg) > rad * rad)
             continue;
-
-        lua_pushinteger(L, i + 1);
-        lua_replace(L, lua_upvalueindex(3));
-
-        ED_PushEdict(L, ent);
-        return 1;
+        list[n++] = ent;
     }
 
-    return 0;
-}
+    // area nodes are in no particular order, keep the old edict order
+    qsort(list, n, sizeof(list[0]), findradius_compare);
 
-/*
-=================
-PF_findradius
+    lua_createtable(L, n, 0);
+    for (i = 0; i < n; i++) {
+        ED_PushEdict(L, list[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
 
-Returns a chain of entities that have origins within a spherical area
+    if (lua_toboolean(L, 3))
+        return 1;
 
-findradius (origin, radius)
-=================
-*/
-int PF_findradius(lua_State *L)
-{
-    lua_pushvalue(L, 1);
-    lua_pushvalue(L, 2);
-    lua_pushnumber(L, 0);
-    lua_pushcclosure(L, findradius_iterator, 3);
+    lua_pushinteger(L, 1);
+    lua_pushcclosure(L, findradius_iterator, 2);
     return 1;
 }
 
@@ -968,6 +1046,7 @@ int PF_droptofloor(lua_State *L)
         lua_pushnumber(L, 0);
     else {
         VectorCopy(trace.endpos, ent->v.origin);
+        SV_MarkNetDirty(ent, ND_ORIGIN);
         SV_LinkEdict(ent, false);
         ent->v.flags = (int) ent->v.flags | FL_ONGROUND;
         ent->v.groundentity = EDICT_TO_PROG(trace.ent);
@@ -995,7 +1074,7 @@ int PF_lightstyle(lua_State *L)
     val = (char *)luaL_checkstring(L, 2);
 
     // change the string in sv
-    sv.lightstyles[style] = val;
+    sv.lightstyles[style] = PR_StrDup(val);
 
     // send message to all clients on this server
     if (sv.state != ss_active)
@@ -1101,6 +1180,43 @@ int PF_entities(lua_State *L)
     return 1;
 }
 
+/*
+=============
+PF_find_by
+
+Walks the engine's classname or targetname index, so only matching
+entities are visited.  Returns the first match after start, or nil.
+
+entity find_by(field, value[, start])
+=============
+*/
+int PF_find_by(lua_State *L)
+{
+    static const char *const fields[] = { "classname", "targetname", NULL };
+    edict_t **start, *ed;
+    int index;
+    string_t key;
+
+    index = luaL_checkoption(L, 1, NULL, fields);
+
+    if (lua_isnil(L, 2))
+        return 0;
+
+    // a string that was never interned can't be a field value
+    key = PR_FindString(luaL_checkstring(L, 2));
+
+    start = NULL;
+    if (!lua_isnoneornil(L, 3))
+        start = luaL_checkudata(L, 3, "edict_t");
+
+    ed = ED_FindIndexed(index, key, start ? *start : NULL);
+    if (!ed)
+        return 0;
+
+    ED_PushEdict(L, ed);
+    return 1;
+}
+
 /*
 ==============
 PF_changeyaw
@@ -1137,6 +1253,7 @@ void PF_changeyaw(void)
     }
 
     ent->v.angles[1] = anglemod(current + move);
+    SV_MarkNetDirty(ent, ND_ANGLES);
 }
 
 /*
@@ -1555,11 +1672,13 @@ void PR_InstallBuiltins(void)
     lua_register(L, "error", PF_error);
     lua_register(L, "vectoyaw", PF_vectoyaw);
     lua_register(L, "traceline", PF_traceline);
+    lua_register(L, "tracelines", PF_tracelines);
     lua_register(L, "break", PF_break);
     lua_register(L, "checkclient", PF_checkclient);
     lua_register(L, "walkmove", PF_walkmove);
     lua_register(L, "checkbottom", PF_checkbottom);
     lua_register(L, "entities", PF_entities);
+    lua_register(L, "find_by", PF_find_by);
 
     // constructor for vec3 data
     lua_register(L, "vec3", PF_vec3);
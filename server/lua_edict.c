@@ -34,14 +34,32 @@ func_t SpectatorConnect;
 func_t SpectatorThink;
 func_t SpectatorDisconnect;
 
+// edict userdata outlive the level, one per slot
+static int ed_slotrefs[MAX_EDICTS];
+
 static void ED_EnsureFields(edict_t *ed)
 {
+    edict_t **ud;
+    int slot;
+
     if (ed->ref == 0) {
-        edict_t **ud = lua_newuserdata(L, sizeof(void*));
+        slot = ((byte *)ed - (byte *)sv.edicts) / pr_edict_size;
+        if (slot < 0 || slot >= MAX_EDICTS)
+            SV_Error("ED_EnsureFields: bad pointer");
+
+        if (ed_slotrefs[slot]) {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, ed_slotrefs[slot]);
+            ud = lua_touserdata(L, -1);
+            lua_pop(L, 1);
+        } else {
+            ud = lua_newuserdata(L, sizeof(void*));
+            luaL_getmetatable(L, "edict_t");
+            lua_setmetatable(L, -2);
+            ed_slotrefs[slot] = luaL_ref(L, LUA_REGISTRYINDEX);
+        }
+
         *ud = ed;
-        luaL_getmetatable(L, "edict_t");
-        lua_setmetatable(L, -2);
-        ed->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        ed->ref = ed_slotrefs[slot];
     }
 
     if (ed->fields == 0) {
@@ -51,6 +69,151 @@ static void ED_EnsureFields(edict_t *ed)
 }
 
 
+/*
+==============================================================================
+
+ENTITY INDEXES
+
+classname and targetname are string table handles, so every edict sharing
+a value is chained from a per-handle head.  Chains are kept in edict order
+so walking one gives the same sequence as the old linear find().
+
+Every write of either field goes through ED_Index, and v is only cleared
+through ED_ClearVars or ED_Free, which take the edict off its chains, so
+the chains are exact.
+
+==============================================================================
+*/
+
+static edict_t *ed_indexheads[NUM_ED_INDEXES][MAX_PRSTR];
+
+static void ED_Unindex(edict_t *ed, int index)
+{
+    edict_t *prev, *next;
+
+    if (!ed->indexkey[index])
+        return;
+
+    prev = ed->indexprev[index];
+    next = ed->indexnext[index];
+
+    if (prev)
+        prev->indexnext[index] = next;
+    else
+        ed_indexheads[index][ed->indexkey[index]] = next;
+    if (next)
+        next->indexprev[index] = prev;
+
+    ed->indexkey[index] = 0;
+    ed->indexnext[index] = ed->indexprev[index] = NULL;
+}
+
+/*
+=================
+ED_Index
+
+Moves an edict to the chain of its new classname or targetname
+=================
+*/
+void ED_Index(edict_t *ed, int index, string_t key)
+{
+    edict_t *prev, *next;
+
+    if (ed->indexkey[index] == key)
+        return;
+
+    ED_Unindex(ed, index);
+    if (!key)
+        return;
+
+    prev = NULL;
+    for (next = ed_indexheads[index][key]; next && next < ed;
+         next = next->indexnext[index])
+        prev = next;
+
+    ed->indexkey[index] = key;
+    ed->indexprev[index] = prev;
+    ed->indexnext[index] = next;
+
+    if (prev)
+        prev->indexnext[index] = ed;
+    else
+        ed_indexheads[index][key] = ed;
+    if (next)
+        next->indexprev[index] = ed;
+}
+
+/*
+=================
+ED_FindIndexed
+
+Returns the first edict after start (or the first one when start is NULL)
+whose indexed field is key
+=================
+*/
+edict_t *ED_FindIndexed(int index, string_t key, edict_t *start)
+{
+    edict_t *ed;
+
+    if (!key)
+        return NULL;
+
+    if (start && start->indexkey[index] == key)
+        ed = start->indexnext[index];
+    else
+        for (ed = ed_indexheads[index][key]; ed && start && ed <= start;
+             ed = ed->indexnext[index])
+            ;
+
+    return ed;
+}
+
+static int ed_stringofs[] = {
+    offsetof(entvars_t, classname),
+    offsetof(entvars_t, model),
+    offsetof(entvars_t, weaponmodel),
+    offsetof(entvars_t, netname),
+    offsetof(entvars_t, target),
+    offsetof(entvars_t, targetname),
+    offsetof(entvars_t, message),
+    offsetof(entvars_t, noise),
+    offsetof(entvars_t, noise1),
+    offsetof(entvars_t, noise2),
+    offsetof(entvars_t, noise3)
+};
+
+// drops the references the string fields hold and clears them
+static void ED_FreeStrings(edict_t * e)
+{
+    string_t *s;
+    int i;
+
+    for (i = 0; i < sizeof(ed_stringofs) / sizeof(ed_stringofs[0]); i++) {
+        s = (string_t *) ((byte *) & e->v + ed_stringofs[i]);
+        PR_FreeString(*s);
+        *s = 0;
+    }
+}
+
+/*
+=================
+ED_ClearVars
+
+Clears v, releasing what its fields hold and taking the edict off the
+index chains
+=================
+*/
+void ED_ClearVars(edict_t * e)
+{
+    int i;
+
+    for (i = 0; i < NUM_ED_INDEXES; i++)
+        ED_Unindex(e, i);
+
+    ED_FreeStrings(e);
+    memset(&e->v, 0, sizeof(entvars_t));
+}
+
 /*
 =================
 ED_ClearEdict
@@ -62,13 +225,16 @@ void ED_ClearEdict(edict_t * e)
 {
     e->free = false;
 
-    memset(&e->v, 0, sizeof(entvars_t));
+    ED_ClearVars(e);
 
     if (e->fields)
         luaL_unref(L, LUA_REGISTRYINDEX, e->fields);
 
     e->fields = 0;
     ED_EnsureFields(e);
+
+    SV_ScheduleThink(e);
+    SV_MarkNetDirty(e, ND_ALL);
 }
 
 /*
@@ -126,26 +292,21 @@ FIXME: walk all entities and NULL out references to this entity
 */
 void ED_Free(edict_t * e)
 {
+    int i;
+
     SV_UnlinkEdict(e); // unlink from world bsp
 
-    FREE_REF(classname);
-    FREE_REF(model);
+    for (i = 0; i < NUM_ED_INDEXES; i++)
+        ED_Unindex(e, i);
+
     FREE_REF(touch);
     FREE_REF(use);
     FREE_REF(think);
     FREE_REF(blocked);
-    FREE_REF(weaponmodel);
-    FREE_REF(netname);
-    FREE_REF(target);
-    FREE_REF(targetname);
-    FREE_REF(message);
-    FREE_REF(noise);
-    FREE_REF(noise1);
-    FREE_REF(noise2);
-    FREE_REF(noise3);
+
+    ED_FreeStrings(e);
 
     e->free = true;
-    e->v.model = 0;
     e->v.takedamage = 0;
     e->v.modelindex = 0;
     e->v.colormap = 0;
@@ -155,6 +316,7 @@ void ED_Free(edict_t * e)
     VectorCopy(vec3_origin, e->v.angles);
     e->v.nextthink = -1;
     e->v.solid = 0;
+    SV_MarkNetDirty(e, ND_ALL);
 
     e->freetime = sv.time;
 }
@@ -213,13 +375,13 @@ qboolean ED_SetField(edict_t *e, const char *key, char *value)
 
     // first handle C fields
     FIELD_FLOAT(sounds);
-    FIELD_STRING(classname);
+    FIELD_INDEXED(classname, ED_INDEX_CLASSNAME);
     FIELD_STRING(message);
     FIELD_VEC(origin);
     FIELD_VEC(angles);
     FIELD_STRING(target);
     FIELD_STRING(model);
-    FIELD_STRING(targetname);
+    FIELD_INDEXED(targetname, ED_INDEX_TARGETNAME);
     FIELD_FLOAT(spawnflags);
     FIELD_FLOAT(health);
 
@@ -259,7 +421,7 @@ char *ED_ParseEdict(char *data, edict_t * ent)
 
     // clear it
     if (ent != sv.edicts) // XXX: refs!
-        memset(&ent->v, 0, sizeof(entvars_t));
+        ED_ClearVars(ent);
 
     // go through all the dictionary pairs
     while (1) {
@@ -412,7 +574,7 @@ void ED_LoadFromFile(char *data)
 
         pr_global_struct->self = ent->ref;
 
-        ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        ref = PR_RefFunction(L);
         PR_ExecuteProgram(ref);
         luaL_unref(L, LUA_REGISTRYINDEX, ref);
 
@@ -433,7 +595,7 @@ int ED_FindFunction(const char *name)
     lua_getglobal(L, name);
 
     if (lua_isfunction(L, -1))
-        return luaL_ref(L, LUA_REGISTRYINDEX);
+        return PR_RefFunction(L);
 
     Con_Printf("Did not find function '%s'\n", name);
 
@@ -441,257 +603,316 @@ int ED_FindFunction(const char *name)
     return LUA_NOREF;
 }
 
-#define PUSH_BOOLEAN(s) \
-    if (strcmp(key, #s) == 0) { \
-        lua_pushboolean(L, (*e)->v.s); \
-        return 1; \
-    }
+/*
+=============================================================================
 
-#define PUSH_FLOAT(s) \
-    if (strcmp(key, #s) == 0) { \
-        lua_pushnumber(L, (*e)->v.s); \
-        return 1; \
-    }
+EDICT FIELD LOOKUP
+
+All C fields of entvars_t are described by ed_fields. Lua interns short
+strings, so once the field names are anchored in the registry every key
+that reaches __index/__newindex for a C field is the very same pointer.
+The hash is keyed on that pointer instead of the string contents.
+
+=============================================================================
+*/
+
+typedef enum {
+    ev_float,
+    ev_vector,
+    ev_string,                  // string table index
+    ev_ref,                     // registry ref (functions)
+    ev_edict,                   // registry ref to an edict_t userdata
+    ev_boolean                  // stored as float
+} etype_t;
+
+typedef struct {
+    const char *name;
+    int ofs;
+    etype_t type;
+    const char *key;            // interned Lua string for name
+    int view;                   // edict_t views slot for vectors
+    int netbits;                // ND_* bit for fields sent to clients
+} edfield_t;
+
+#define ED_FIELD(n, t) { #n, offsetof(entvars_t, n), t, NULL, -1, 0 }
+#define ED_NETFIELD(n, t, b) { #n, offsetof(entvars_t, n), t, NULL, -1, b }
+
+static edfield_t ed_fields[] = {
+    ED_NETFIELD(modelindex, ev_float, ND_MODEL),
+    ED_FIELD(absmin, ev_vector),
+    ED_FIELD(absmax, ev_vector),
+    ED_FIELD(ltime, ev_float),
+    ED_FIELD(lastruntime, ev_float),
+    ED_FIELD(movetype, ev_float),
+    ED_FIELD(solid, ev_float),
+    ED_NETFIELD(origin, ev_vector, ND_ORIGIN),
+    ED_FIELD(oldorigin, ev_vector),
+    ED_FIELD(velocity, ev_vector),
+    ED_NETFIELD(angles, ev_vector, ND_ANGLES),
+    ED_FIELD(avelocity, ev_vector),
+    ED_FIELD(classname, ev_string),
+    ED_FIELD(model, ev_string),
+    ED_NETFIELD(frame, ev_float, ND_FRAME),
+    ED_NETFIELD(skin, ev_float, ND_SKIN),
+    ED_NETFIELD(effects, ev_float, ND_EFFECTS),
+    ED_FIELD(mins, ev_vector),
+    ED_FIELD(maxs, ev_vector),
+    ED_FIELD(size, ev_vector),
+    ED_FIELD(touch, ev_ref),
+    ED_FIELD(use, ev_ref),
+    ED_FIELD(think, ev_ref),
+    ED_FIELD(blocked, ev_ref),
+    ED_FIELD(nextthink, ev_float),
+    ED_FIELD(groundentity, ev_edict),
+    ED_FIELD(health, ev_float),
+    ED_FIELD(frags, ev_float),
+    ED_FIELD(weapon, ev_float),
+    ED_FIELD(weaponmodel, ev_string),
+    ED_FIELD(weaponframe, ev_float),
+    ED_FIELD(currentammo, ev_float),
+    ED_FIELD(ammo_shells, ev_float),
+    ED_FIELD(ammo_nails, ev_float),
+    ED_FIELD(ammo_rockets, ev_float),
+    ED_FIELD(ammo_cells, ev_float),
+    ED_FIELD(items, ev_float),
+    ED_FIELD(takedamage, ev_float),
+    ED_FIELD(chain, ev_edict),
+    ED_FIELD(deadflag, ev_float),
+    ED_FIELD(view_ofs, ev_vector),
+    ED_FIELD(button0, ev_float),
+    ED_FIELD(button1, ev_float),
+    ED_FIELD(button2, ev_float),
+    ED_FIELD(impulse, ev_float),
+    ED_FIELD(fixangle, ev_boolean),
+    ED_FIELD(v_angle, ev_vector),
+    ED_FIELD(netname, ev_string),
+    ED_FIELD(enemy, ev_edict),
+    ED_FIELD(flags, ev_float),
+    ED_NETFIELD(colormap, ev_float, ND_COLORMAP),
+    ED_FIELD(team, ev_float),
+    ED_FIELD(max_health, ev_float),
+    ED_FIELD(teleport_time, ev_float),
+    ED_FIELD(armortype, ev_float),
+    ED_FIELD(armorvalue, ev_float),
+    ED_FIELD(waterlevel, ev_float),
+    ED_FIELD(watertype, ev_float),
+    ED_FIELD(ideal_yaw, ev_float),
+    ED_FIELD(yaw_speed, ev_float),
+    ED_FIELD(aiment, ev_edict),
+    ED_FIELD(goalentity, ev_edict),
+    ED_FIELD(spawnflags, ev_float),
+    ED_FIELD(target, ev_string),
+    ED_FIELD(targetname, ev_string),
+    ED_FIELD(dmg_take, ev_float),
+    ED_FIELD(dmg_save, ev_float),
+    ED_FIELD(dmg_inflictor, ev_edict),
+    ED_FIELD(owner, ev_edict),
+    ED_FIELD(movedir, ev_vector),
+    ED_FIELD(message, ev_string),
+    ED_FIELD(sounds, ev_float),
+    ED_FIELD(noise, ev_string),
+    ED_FIELD(noise1, ev_string),
+    ED_FIELD(noise2, ev_string),
+    ED_FIELD(noise3, ev_string),
+};
+
+#define NUM_ED_FIELDS   (sizeof(ed_fields) / sizeof(ed_fields[0]))
+#define FIELDHASH_SIZE  256     // power of two, keep load under 1/2
+
+static edfield_t *ed_fieldhash[FIELDHASH_SIZE];
+static qboolean ed_usefieldhash = true;
+
+static unsigned ED_HashKey(const char *key)
+{
+    return (unsigned)(((size_t)key >> 3) * 2654435761u) & (FIELDHASH_SIZE - 1);
+}
+
+/*
+=============
+ED_InitFieldHash
+
+Interns every field name and anchors the strings in a registry table so
+they are never collected (and their address never changes) while this
+lua_State lives.
+=============
+*/
+static void ED_InitFieldHash(void)
+{
+    edfield_t *f;
+    unsigned h;
+    int i, views;
+
+    memset(ed_fieldhash, 0, sizeof(ed_fieldhash));
+    views = 0;
+
+    lua_createtable(L, NUM_ED_FIELDS, 0);
 
-#define PUSH_REF(s) \
-    if (strcmp(key, #s) == 0) { \
-        if ((*e)->v.s == 0) \
-            lua_pushnil(L); \
-        else \
-            lua_rawgeti(L, LUA_REGISTRYINDEX, (*e)->v.s); \
-        return 1; \
+    for (i = 0, f = ed_fields; i < NUM_ED_FIELDS; i++, f++) {
+        lua_pushstring(L, f->name);
+        f->key = lua_tostring(L, -1);
+        lua_rawseti(L, -2, i + 1);
+
+        if (f->type == ev_vector) {
+            if (views == NUM_ED_VECTORS)
+                SV_Error("ED_InitFieldHash: NUM_ED_VECTORS is too small");
+            f->view = views++;
+        }
+
+        for (h = ED_HashKey(f->key); ed_fieldhash[h]; h = (h + 1) & (FIELDHASH_SIZE - 1))
+            ;
+        ed_fieldhash[h] = f;
     }
 
-#define PUSH_VEC3(s) \
-    if (strcmp(key, #s) == 0) { \
-        PR_Vec3_Push(L, (*e)->v.s); \
-        return 1; \
+    luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+/*
+=============
+ED_FindField
+
+Returns the C field for the key at index or NULL if it's a Lua-only field.
+=============
+*/
+static edfield_t *ED_FindField(lua_State *L, int index)
+{
+    const char *key;
+    unsigned h;
+    int i;
+
+    if (lua_type(L, index) != LUA_TSTRING)
+        return NULL;
+
+    key = lua_tostring(L, index);
+
+    if (!ed_usefieldhash) {
+        // old behaviour, kept for edictbench comparisons
+        for (i = 0; i < NUM_ED_FIELDS; i++)
+            if (strcmp(key, ed_fields[i].name) == 0)
+                return &ed_fields[i];
+        return NULL;
     }
 
+    for (h = ED_HashKey(key); ed_fieldhash[h]; h = (h + 1) & (FIELDHASH_SIZE - 1))
+        if (ed_fieldhash[h]->key == key)
+            return ed_fieldhash[h];
+
+    return NULL;
+}
+
 static int ED_mt_index(lua_State *L)
 {
     edict_t **e;
-    const char *key;
+    edfield_t *f;
+    void *p;
 
     e = luaL_checkudata(L, 1, "edict_t");
-    key = lua_tostring(L, 2);
 
     // first handle C fields
-    PUSH_FLOAT(modelindex);
-    PUSH_VEC3(absmin);
-    PUSH_VEC3(absmax);
-    PUSH_FLOAT(ltime);
-    PUSH_FLOAT(lastruntime);
-    PUSH_FLOAT(movetype);
-    PUSH_FLOAT(solid);
-    PUSH_VEC3(origin);
-    PUSH_VEC3(oldorigin);
-    PUSH_VEC3(velocity);
-    PUSH_VEC3(angles);
-    PUSH_VEC3(avelocity);
-    PUSH_REF(classname);
-    PUSH_REF(model);
-    PUSH_FLOAT(frame);
-    PUSH_FLOAT(skin);
-    PUSH_FLOAT(effects);
-    PUSH_VEC3(mins);
-    PUSH_VEC3(maxs);
-    PUSH_VEC3(size);
-    PUSH_REF(touch);
-    PUSH_REF(use);
-    PUSH_REF(think);
-    PUSH_REF(blocked);
-    PUSH_FLOAT(nextthink);
-    PUSH_REF(groundentity);
-    PUSH_FLOAT(health);
-    PUSH_FLOAT(frags);
-    PUSH_FLOAT(weapon);
-    PUSH_REF(weaponmodel);
-    PUSH_FLOAT(weaponframe);
-    PUSH_FLOAT(currentammo);
-    PUSH_FLOAT(ammo_shells);
-    PUSH_FLOAT(ammo_nails);
-    PUSH_FLOAT(ammo_rockets);
-    PUSH_FLOAT(ammo_cells);
-    PUSH_FLOAT(items);
-    PUSH_FLOAT(takedamage);
-    PUSH_REF(chain);
-    PUSH_FLOAT(deadflag);
-    PUSH_VEC3(view_ofs);
-    PUSH_FLOAT(button0);
-    PUSH_FLOAT(button1);
-    PUSH_FLOAT(button2);
-    PUSH_FLOAT(impulse);
-    PUSH_BOOLEAN(fixangle);
-    PUSH_VEC3(v_angle);
-    PUSH_REF(netname);
-    PUSH_REF(enemy);
-    PUSH_FLOAT(flags);
-    PUSH_FLOAT(colormap);
-    PUSH_FLOAT(team);
-    PUSH_FLOAT(max_health);
-    PUSH_FLOAT(teleport_time);
-    PUSH_FLOAT(armortype);
-    PUSH_FLOAT(armorvalue);
-    PUSH_FLOAT(waterlevel);
-    PUSH_FLOAT(watertype);
-    PUSH_FLOAT(ideal_yaw);
-    PUSH_FLOAT(yaw_speed);
-    PUSH_REF(aiment);
-    PUSH_REF(goalentity);
-    PUSH_FLOAT(spawnflags);
-    PUSH_REF(target);
-    PUSH_REF(targetname);
-    PUSH_FLOAT(dmg_take);
-    PUSH_FLOAT(dmg_save);
-    PUSH_REF(dmg_inflictor);
-    PUSH_REF(owner);
-    PUSH_VEC3(movedir);
-    PUSH_REF(message);
-    PUSH_FLOAT(sounds);
-    PUSH_REF(noise);
-    PUSH_REF(noise1);
-    PUSH_REF(noise2);
-    PUSH_REF(noise3);
+    if ((f = ED_FindField(L, 2))) {
+        p = (byte *)&(*e)->v + f->ofs;
+
+        switch (f->type) {
+        case ev_float:
+            lua_pushnumber(L, *(float *)p);
+            break;
+        case ev_boolean:
+            lua_pushboolean(L, *(float *)p);
+            break;
+        case ev_vector:
+            PR_Vec3_PushView(L, (vec_t *)p, &(*e)->views[f->view]);
+            break;
+        case ev_string:
+            PR_PushString(L, *(int *)p);
+            break;
+        case ev_ref:
+        case ev_edict:
+            if (*(int *)p == 0)
+                lua_pushnil(L);
+            else
+                lua_rawgeti(L, LUA_REGISTRYINDEX, *(int *)p);
+            break;
+        }
+
+        return 1;
+    }
 
     lua_rawgeti(L, LUA_REGISTRYINDEX, (*e)->fields);
-    lua_pushstring(L, key);
+    lua_pushvalue(L, 2);
     lua_rawget(L, -2);
     lua_remove(L, -2);
 
     return 1;
 }
 
-#define SET_BOOLEAN(s)  \
-    if (strcmp(key, #s) == 0) { \
-        luaL_checktype(L, 3, LUA_TBOOLEAN); \
-        (*e)->v.s = lua_toboolean(L, 3); \
-        return 0; \
-    }
-
-#define SET_FLOAT(s)  \
-    if (strcmp(key, #s) == 0) { \
-        (*e)->v.s = luaL_checknumber(L, 3); \
-        return 0; \
-    }
-
-#define SET_VEC3(s) \
-    if (strcmp(key, #s) == 0) { \
-        vec_t *_tmpvec; \
-        _tmpvec = PR_Vec3_ToVec(L, 3); \
-        memcpy((*e)->v.s, _tmpvec, sizeof(vec3_t)); \
-        return 0; \
-    }
-
-#define SET_REF(s)  \
-    if (strcmp(key, #s) == 0) { \
-        if ((*e)->v.s) luaL_unref(L, LUA_REGISTRYINDEX, (*e)->v.s); \
-        (*e)->v.s = 0; \
-        if (!lua_isnil(L, 3)) { \
-            lua_pushvalue(L, 3); \
-            (*e)->v.s = luaL_ref(L, LUA_REGISTRYINDEX); \
-        } \
-        return 0; \
-    }
-
-#define SET_EDICT(s)  \
-    if (strcmp(key, #s) == 0) { \
-        (*e)->v.s = 0; \
-        if (!lua_isnil(L, 3)) { \
-            e2 = luaL_checkudata(L, 3, "edict_t"); \
-            (*e)->v.s = (*e2)->ref; \
-        } \
-        return 0; \
-    }
-
 static int ED_mt_newindex(lua_State *L)
 {
     edict_t **e, **e2;
-    const char *key;
+    edfield_t *f;
+    void *p;
+    float value;
+    vec_t *v;
 
     e = luaL_checkudata(L, 1, "edict_t");
-    key = lua_tostring(L, 2);
 
     // first handle C fields
-    SET_FLOAT(modelindex);
-    SET_VEC3(absmin);
-    SET_VEC3(absmax);
-    SET_FLOAT(ltime);
-    SET_FLOAT(lastruntime);
-    SET_FLOAT(movetype);
-    SET_FLOAT(solid);
-    SET_VEC3(origin);
-    SET_VEC3(oldorigin);
-    SET_VEC3(velocity);
-    SET_VEC3(angles);
-    SET_VEC3(avelocity);
-    SET_REF(classname);
-    SET_REF(model);
-    SET_FLOAT(frame);
-    SET_FLOAT(skin);
-    SET_FLOAT(effects);
-    SET_VEC3(mins);
-    SET_VEC3(maxs);
-    SET_VEC3(size);
-    SET_REF(touch);
-    SET_REF(use);
-    SET_REF(think);
-    SET_REF(blocked);
-    SET_FLOAT(nextthink);
-    SET_EDICT(groundentity);
-    SET_FLOAT(health);
-    SET_FLOAT(frags);
-    SET_FLOAT(weapon);
-    SET_REF(weaponmodel);
-    SET_FLOAT(weaponframe);
-    SET_FLOAT(currentammo);
-    SET_FLOAT(ammo_shells);
-    SET_FLOAT(ammo_nails);
-    SET_FLOAT(ammo_rockets);
-    SET_FLOAT(ammo_cells);
-    SET_FLOAT(items);
-    SET_FLOAT(takedamage);
-    SET_EDICT(chain);
-    SET_FLOAT(deadflag);
-    SET_VEC3(view_ofs);
-    SET_FLOAT(button0);
-    SET_FLOAT(button1);
-    SET_FLOAT(button2);
-    SET_FLOAT(impulse);
-    SET_BOOLEAN(fixangle);
-    SET_VEC3(v_angle);
-    SET_REF(netname);
-    SET_EDICT(enemy);
-    SET_FLOAT(flags);
-    SET_FLOAT(colormap);
-    SET_FLOAT(team);
-    SET_FLOAT(max_health);
-    SET_FLOAT(teleport_time);
-    SET_FLOAT(armortype);
-    SET_FLOAT(armorvalue);
-    SET_FLOAT(waterlevel);
-    SET_FLOAT(watertype);
-    SET_FLOAT(ideal_yaw);
-    SET_FLOAT(yaw_speed);
-    SET_EDICT(aiment);
-    SET_EDICT(goalentity);
-    SET_FLOAT(spawnflags);
-    SET_REF(target);
-    SET_REF(targetname);
-    SET_FLOAT(dmg_take);
-    SET_FLOAT(dmg_save);
-    SET_EDICT(dmg_inflictor);
-    SET_EDICT(owner);
-    SET_VEC3(movedir);
-    SET_REF(message);
-    SET_FLOAT(sounds);
-    SET_REF(noise);
-    SET_REF(noise1);
-    SET_REF(noise2);
-    SET_REF(noise3);
+    if ((f = ED_FindField(L, 2))) {
+        p = (byte *)&(*e)->v + f->ofs;
+
+        // only real changes of network fields are marked, animation code
+        // tends to write the same frame over and over
+        switch (f->type) {
+        case ev_float:
+            value = luaL_checknumber(L, 3);
+            if (f->netbits && *(float *)p != value)
+                SV_MarkNetDirty(*e, f->netbits);
+            *(float *)p = value;
+            if ((f->ofs == offsetof(entvars_t, nextthink)
+                 || f->ofs == offsetof(entvars_t, movetype)) && !(*e)->free)
+                SV_ScheduleThink(*e);
+            break;
+        case ev_boolean:
+            luaL_checktype(L, 3, LUA_TBOOLEAN);
+            *(float *)p = lua_toboolean(L, 3);
+            break;
+        case ev_vector:
+            v = PR_Vec3_ToVec(L, 3);
+            if (f->netbits && !VectorCompare((vec_t *)p, v))
+                SV_MarkNetDirty(*e, f->netbits);
+            memcpy(p, v, sizeof(vec3_t));
+            break;
+        case ev_string:
+            PR_ReplaceString((string_t *)p, lua_isnil(L, 3) ? NULL :
+                             (char *)luaL_checkstring(L, 3));
+            if ((*e)->free)
+                break;
+            if (f->ofs == offsetof(entvars_t, classname))
+                ED_Index(*e, ED_INDEX_CLASSNAME, *(int *)p);
+            else if (f->ofs == offsetof(entvars_t, targetname))
+                ED_Index(*e, ED_INDEX_TARGETNAME, *(int *)p);
+            break;
+        case ev_ref:
+            if (*(int *)p)
+                luaL_unref(L, LUA_REGISTRYINDEX, *(int *)p);
+            *(int *)p = 0;
+            if (!lua_isnil(L, 3)) {
+                lua_pushvalue(L, 3);
+                *(int *)p = PR_RefFunction(L);
+            }
+            break;
+        case ev_edict:
+            *(int *)p = 0;
+            if (!lua_isnil(L, 3)) {
+                e2 = luaL_checkudata(L, 3, "edict_t");
+                *(int *)p = (*e2)->ref;
+            }
+            break;
+        }
+
+        return 0;
+    }
 
     lua_rawgeti(L, LUA_REGISTRYINDEX, (*e)->fields);
-    lua_pushstring(L, key);
+    lua_pushvalue(L, 2);
 
     // deep copy of vec3_t when assigning
     if (luaL_testudata(L, 3, "vec3_t")) {
@@ -709,6 +930,36 @@ static int ED_mt_newindex(lua_State *L)
     return 0;
 }
 
+/*
+=============
+ED_VectorWritten
+
+vec3_t views write straight into the edict, self.angles.y = 90 never gets
+to ED_mt_newindex.  Marks the network field v belongs to, if any.
+=============
+*/
+void ED_VectorWritten(vec_t *v)
+{
+    edict_t *e;
+    byte *p;
+    int ofs;
+
+    p = (byte *)v;
+    if (!sv.edicts || p < (byte *)sv.edicts
+        || p >= (byte *)sv.edicts + MAX_EDICTS * pr_edict_size)
+        return;
+
+    e = EDICT_NUM((p - (byte *)sv.edicts) / pr_edict_size);
+    ofs = p - (byte *)&e->v;
+
+    if (ofs >= offsetof(entvars_t, origin)
+        && ofs < offsetof(entvars_t, origin) + sizeof(vec3_t))
+        SV_MarkNetDirty(e, ND_ORIGIN);
+    else if (ofs >= offsetof(entvars_t, angles)
+             && ofs < offsetof(entvars_t, angles) + sizeof(vec3_t))
+        SV_MarkNetDirty(e, ND_ANGLES);
+}
+
 static int ED_mt_tostring(lua_State *L)
 {
     static char buf[32];
@@ -728,61 +979,559 @@ static const luaL_Reg ED_mt[] = {
     {0, 0}
 };
 
+/*
+=============================================================================
+
+PROGS LOADING
+
+The lua_State lives as long as the server. Every level the game modules
+are run again on a fresh set of globals, but they are only compiled from
+source when their text changed: compiled chunks are kept in memory and as
+bytecode in <gamedir>/luac/, keyed by the checksum of the source.  Lua
+does not check bytecode it loads, so the cached files also carry a
+checksum of the bytecode itself and are only ever written whole.
+
+=============================================================================
+*/
+
+#define CHUNK_ID        "QLUC"
+
+#define CHUNK_MAXSIZE   (16 * 1024 * 1024)
+
+typedef struct {
+    char id[4];
+    int version;
+    int checksum;               // of the source
+    int size;                   // of the source
+    int bodychecksum;           // of the bytecode after the header
+    int bodysize;
+} chunkheader_t;
+
+typedef struct {
+    byte *data;
+    int size;
+    int maxsize;
+} chunkwriter_t;
+
+static int pr_chunks;           // registry ref: compiled chunks by key
+static int pr_modules;          // registry ref: modules found by us
+static int pr_baseglobals;      // registry ref: _G before the game ran
+
+// whether the function behind a registry ref takes parameters, set by
+// PR_RefFunction
+static byte *pr_fnparams;
+static int pr_numfnparams;
+
+// stale edict references from a previous level point here until their
+// slot is used again
+static edict_t ed_dead;
+
+static int PR_ChunkWriter(lua_State *L, const void *p, size_t size, void *ud)
+{
+    chunkwriter_t *w = ud;
+    byte *data;
+    int max;
+
+    if (w->size + size > CHUNK_MAXSIZE)
+        return 1;
+
+    if (w->size + size > w->maxsize) {
+        for (max = w->maxsize ? w->maxsize : 4096; max < w->size + size; max *= 2)
+            ;
+        data = realloc(w->data, max);
+        if (!data)
+            return 1;
+        w->data = data;
+        w->maxsize = max;
+    }
+
+    memcpy(w->data + w->size, p, size);
+    w->size += size;
+    return 0;
+}
+
 /*
 ===============
-PR_LoadProgs
+PR_LoadCachedChunk
+
+Pushes the bytecode for name if the cache matches the source.
 ===============
 */
-void PR_LoadProgs(void)
+static qboolean PR_LoadCachedChunk(const char *name, unsigned checksum, int size)
 {
-    const char *path;
-    char *buf;
-    byte* code;
+    chunkheader_t header;
+    byte *body;
+    qboolean ok;
+    FILE *f;
+    int len;
+
+    f = fopen(va("%s/luac/%s.luac", com_gamedir, name), "rb");
+    if (!f)
+        return false;
+
+    ok = fread(&header, sizeof(header), 1, f) == 1
+        && !memcmp(header.id, CHUNK_ID, 4)
+        && LittleLong(header.version) == LUA_VERSION_NUM
+        && LittleLong(header.checksum) == checksum
+        && LittleLong(header.size) == size;
+
+    body = NULL;
+    len = LittleLong(header.bodysize);
+    if (ok && (len <= 0 || len > CHUNK_MAXSIZE))
+        ok = false;
+
+    if (ok) {
+        body = malloc(len);
+        ok = body && fread(body, 1, len, f) == len
+            && Com_BlockChecksum(body, len) == LittleLong(header.bodychecksum);
+    }
+    fclose(f);
 
-    // shared state
-    pr_global_struct = Z_Malloc(sizeof *pr_global_struct);
+    if (!ok) {
+        free(body);
+        return false;
+    }
 
-    // sv_init.c compatibility
-    pr_edict_size = sizeof(edict_t);
-    pr_strings = ""; // uh?
+    if (luaL_loadbufferx(L, (char *)body, len, name, "b") != LUA_OK) {
+        Con_DPrintf("%s\n", lua_tostring(L, -1));
+        lua_pop(L, 1);
+        ok = false;
+    }
 
-    // sv_user.c compatibility
-    progs = Z_Malloc(sizeof *progs);
-    progs->entityfields = sizeof(((edict_t *)0)->v) / 4;
+    free(body);
+    return ok;
+}
 
-    // sv_ccmds.c compatibility
-    num_prstr = 0;
+/*
+===============
+PR_SaveCachedChunk
 
-    L = luaL_newstate();
-    luaL_openlibs(L);
+Writes the compiled chunk on top of the stack next to the cache file and
+renames it into place, so a cache file is never left half written.
+===============
+*/
+static void PR_SaveCachedChunk(const char *name, unsigned checksum, int size)
+{
+    chunkheader_t header;
+    chunkwriter_t w;
+    char path[MAX_OSPATH], tmp[MAX_OSPATH];
+    qboolean ok;
+    FILE *f;
+
+    memset(&w, 0, sizeof(w));
+    if (lua_dump(L, PR_ChunkWriter, &w, 0) || !w.size) {
+        free(w.data);
+        return;
+    }
 
-    // weird trick to append to packages.path
-    lua_newtable(L);
-    lua_getglobal(L, "package");
-    lua_getfield(L, -1, "path");
-    path = lua_tostring(L, -1);
+    snprintf(path, sizeof(path), "%s/luac/%s.luac", com_gamedir, name);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    COM_CreatePath(path);
+
+    f = fopen(tmp, "wb");
+    if (!f) {
+        Con_DPrintf("Couldn't write %s\n", tmp);
+        free(w.data);
+        return;
+    }
 
-    buf = Z_Malloc(strlen(path) + strlen(com_gamedir) + 8);
-    sprintf(buf, "%s;%s/?.lua", path, com_gamedir);
+    memcpy(header.id, CHUNK_ID, 4);
+    header.version = LittleLong(LUA_VERSION_NUM);
+    header.checksum = LittleLong(checksum);
+    header.size = LittleLong(size);
+    header.bodychecksum = LittleLong(Com_BlockChecksum(w.data, w.size));
+    header.bodysize = LittleLong(w.size);
+
+    ok = fwrite(&header, sizeof(header), 1, f) == 1
+        && fwrite(w.data, 1, w.size, f) == w.size;
+    ok = !fclose(f) && ok;
+    free(w.data);
+
+    // rename doesn't replace an existing file everywhere
+    if (ok && rename(tmp, path)) {
+        remove(path);
+        ok = !rename(tmp, path);
+    }
 
-    lua_pushstring(L, buf);
-    lua_setfield(L, -3, "path");
+    if (!ok) {
+        Con_DPrintf("Couldn't write %s\n", path);
+        remove(tmp);
+    }
+}
+
+/*
+===============
+PR_LoadChunk
+
+Pushes the compiled chunk for a module in the gamedir, dots in the
+name are directories like in package.path.
+===============
+*/
+static qboolean PR_LoadChunk(const char *name)
+{
+    char path[MAX_OSPATH];
+    char *s;
+    byte *src;
+    unsigned checksum;
+    int size;
+
+    if (strlen(name) + 5 > sizeof(path))
+        return false;
+
+    sprintf(path, "%s.lua", name);
+    for (s = path; *s && strcmp(s, ".lua"); s++)
+        if (*s == '.')
+            *s = '/';
+
+    src = COM_LoadTempFile(path);
+    if (!src)
+        return false;
+
+    size = com_filesize;
+    checksum = Com_BlockChecksum(src, size);
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, pr_chunks);
+    lua_pushfstring(L, "%s:%d:%d", name, (int)checksum, size);
+
+    lua_pushvalue(L, -1);
+    if (lua_rawget(L, -3) == LUA_TFUNCTION) {
+        lua_remove(L, -2);
+        lua_remove(L, -2);
+        return true;
+    }
+    lua_pop(L, 1);
+
+    if (!PR_LoadCachedChunk(name, checksum, size)) {
+        if (luaL_loadbufferx(L, (char *)src, size, va("@%s", path), "t") != LUA_OK)
+            SV_Error((char *)lua_tostring(L, -1));
+        PR_SaveCachedChunk(name, checksum, size);
+    }
+
+    // chunks[key] = function
+    lua_pushvalue(L, -1);
+    lua_insert(L, -3);
+    lua_rawset(L, -4);
+    lua_remove(L, -2);
+
+    return true;
+}
+
+/*
+===============
+PR_SearchGamedir
+
+package.searchers entry for require
+===============
+*/
+static int PR_SearchGamedir(lua_State *L)
+{
+    const char *name;
+
+    name = luaL_checkstring(L, 1);
+
+    if (!PR_LoadChunk(name)) {
+        lua_pushfstring(L, "\n\tno file '%s.lua' in gamedir", name);
+        return 1;
+    }
+
+    // remember it so it's required again on the next level
+    lua_rawgeti(L, LUA_REGISTRYINDEX, pr_modules);
+    lua_pushboolean(L, true);
+    lua_setfield(L, -2, name);
+    lua_pop(L, 1);
+
+    lua_pushstring(L, name);
+    return 2;
+}
+
+static int PR_Panic(lua_State *L)
+{
+    Sys_Error("Lua: %s", lua_tostring(L, -1));
+    return 0;
+}
+
+/*
+===============
+PR_GlobalIndex
+
+self, other, time and force_retouch are never stored in _G.  Reading or
+writing them goes to pr_global_struct, so nothing has to be pushed before
+each call and builtins see the self the game set.
+===============
+*/
+static int PR_GlobalIndex(lua_State *L)
+{
+    const char *key;
+
+    if (lua_type(L, 2) != LUA_TSTRING)
+        return 0;
+    key = lua_tostring(L, 2);
+
+    if (!strcmp(key, "self")) {
+        PUSH_GARG(self);
+    } else if (!strcmp(key, "other")) {
+        PUSH_GARG(other);
+    } else if (!strcmp(key, "time"))
+        lua_pushnumber(L, pr_global_struct->time);
+    else if (!strcmp(key, "force_retouch"))
+        lua_pushnumber(L, pr_global_struct->force_retouch);
+    else
+        return 0;
+
+    return 1;
+}
+
+static int PR_GlobalNewindex(lua_State *L)
+{
+    const char *key;
+    edict_t **e;
+    int *ref;
+
+    key = lua_type(L, 2) == LUA_TSTRING ? lua_tostring(L, 2) : "";
+
+    if (!strcmp(key, "self"))
+        ref = &pr_global_struct->self;
+    else if (!strcmp(key, "other"))
+        ref = &pr_global_struct->other;
+    else if (!strcmp(key, "time")) {
+        pr_global_struct->time = luaL_checknumber(L, 3);
+        return 0;
+    } else if (!strcmp(key, "force_retouch")) {
+        pr_global_struct->force_retouch = luaL_checknumber(L, 3);
+        return 0;
+    } else {
+        lua_rawset(L, 1);
+        return 0;
+    }
+
+    *ref = 0;
+    if (!lua_isnil(L, 3)) {
+        e = luaL_checkudata(L, 3, "edict_t");
+        *ref = (*e)->ref;
+    }
+    return 0;
+}
+
+static const luaL_Reg PR_globals_mt[] = {
+    {"__index", PR_GlobalIndex},
+    {"__newindex", PR_GlobalNewindex},
+    {NULL, NULL}
+};
+
+/*
+===============
+PR_InitState
+
+Creates the lua_State, called once
+===============
+*/
+static void PR_InitState(void)
+{
+    int i;
+
+    L = lua_newstate(PR_Alloc, NULL);
+    if (!L)
+        Sys_Error("PR_InitState: couldn't create the Lua state");
+    lua_atpanic(L, PR_Panic);
+    luaL_openlibs(L);
+
+    // look in the gamedir before anything else package.path has
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "searchers");
+    for (i = lua_rawlen(L, -1); i >= 2; i--) {
+        lua_rawgeti(L, -1, i);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_pushcfunction(L, PR_SearchGamedir);
+    lua_rawseti(L, -2, 2);
     lua_pop(L, 2);
 
     PR_Vec3_Init(L);
+    PR_Trace_Init(L);
 
     luaL_newmetatable(L, "edict_t");
     luaL_setfuncs(L, ED_mt, 0);
     lua_pop(L, 1);
 
+    ED_InitFieldHash();
+
     PR_InstallBuiltins();
 
-    code = COM_LoadHunkFile("qwprogs.lua");
-    if (!code)
-        SV_Error("No qwprogs.lua found.");
+    lua_pushglobaltable(L);
+    lua_newtable(L);
+    luaL_setfuncs(L, PR_globals_mt, 0);
+    lua_setmetatable(L, -2);
+    lua_pop(L, 1);
 
-    if (luaL_loadstring(L, (char *)code) != LUA_OK)
-        SV_Error((char *)lua_tostring(L, -1));
+    lua_newtable(L);
+    pr_chunks = luaL_ref(L, LUA_REGISTRYINDEX);
+    lua_newtable(L);
+    pr_modules = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    // snapshot of the globals the game starts every level with
+    lua_newtable(L);
+    lua_pushglobaltable(L);
+    lua_pushnil(L);
+    while (lua_next(L, -2)) {
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, -5);
+    }
+    lua_pop(L, 1);
+    pr_baseglobals = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    ed_dead.free = true;
+    lua_newtable(L);
+    ed_dead.fields = luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+/*
+===============
+PR_ResetGlobals
+
+Puts _G back to how it was before the game ran and forgets the game
+modules so they are run again.
+===============
+*/
+static void PR_ResetGlobals(void)
+{
+    qboolean base;
+
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "loaded");
+    lua_rawgeti(L, LUA_REGISTRYINDEX, pr_modules);
+    lua_pushnil(L);
+    while (lua_next(L, -2)) {
+        lua_pop(L, 1);
+        lua_pushvalue(L, -1);
+        lua_pushnil(L);
+        lua_rawset(L, -5);
+    }
+    lua_pop(L, 3);
+
+    lua_pushglobaltable(L);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, pr_baseglobals);
+
+    // remove everything the game added
+    lua_pushnil(L);
+    while (lua_next(L, -3)) {
+        lua_pop(L, 1);
+        lua_pushvalue(L, -1);
+        base = lua_rawget(L, -3) != LUA_TNIL;
+        lua_pop(L, 1);
+
+        if (!base) {
+            lua_pushvalue(L, -1);
+            lua_pushnil(L);
+            lua_rawset(L, -5);
+        }
+    }
+
+    // and restore what it replaced
+    lua_pushnil(L);
+    while (lua_next(L, -2)) {
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, -5);
+    }
+
+    lua_pop(L, 2);
+}
+
+/*
+===============
+PR_ClearLevel
+
+Releases everything the Lua state holds for the current level's edicts,
+called before the level's hunk memory goes away.
+===============
+*/
+void PR_ClearLevel(void)
+{
+    edict_t *e, **ud;
+    int i, j;
+
+    // string handles are about to be reused
+    memset(ed_indexheads, 0, sizeof(ed_indexheads));
+
+    if (!L || !sv.edicts)
+        return;
+
+    for (i = 0; i < sv.num_edicts; i++) {
+        e = EDICT_NUM(i);
+
+        FREE_REF(touch);
+        FREE_REF(use);
+        FREE_REF(think);
+        FREE_REF(blocked);
+
+        if (e->fields)
+            luaL_unref(L, LUA_REGISTRYINDEX, e->fields);
+        e->fields = 0;
+
+        for (j = 0; j < NUM_ED_VECTORS; j++) {
+            if (e->views[j])
+                luaL_unref(L, LUA_REGISTRYINDEX, e->views[j]);
+            e->views[j] = 0;
+        }
+
+        // the userdata itself is kept for the slot
+        if (e->ref) {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, e->ref);
+            ud = lua_touserdata(L, -1);
+            *ud = &ed_dead;
+            lua_pop(L, 1);
+        }
+    }
+}
+
+/*
+===============
+PR_LoadProgs
+===============
+*/
+void PR_LoadProgs(void)
+{
+    func_t *f;
+    double start;
+
+    start = Sys_DoubleTime();
+
+    if (!L) {
+        // shared state
+        pr_global_struct = Z_Malloc(sizeof *pr_global_struct);
+
+        // sv_init.c compatibility
+        pr_edict_size = sizeof(edict_t);
+        pr_strings = ""; // uh?
+
+        // sv_user.c compatibility
+        progs = Z_Malloc(sizeof *progs);
+        progs->entityfields = sizeof(((edict_t *)0)->v) / 4;
+
+        PR_InitState();
+    } else {
+        for (f = &pr_global_struct->main; f <= &pr_global_struct->SetChangeParms; f++)
+            if (*f > 0)
+                luaL_unref(L, LUA_REGISTRYINDEX, *f);
+        if (SpectatorConnect > 0)
+            luaL_unref(L, LUA_REGISTRYINDEX, SpectatorConnect);
+        if (SpectatorThink > 0)
+            luaL_unref(L, LUA_REGISTRYINDEX, SpectatorThink);
+        if (SpectatorDisconnect > 0)
+            luaL_unref(L, LUA_REGISTRYINDEX, SpectatorDisconnect);
+
+        PR_ResetGlobals();
+    }
+
+    memset(pr_global_struct, 0, sizeof(*pr_global_struct));
+    PR_ClearStrings();
+
+    // collect the previous level
+    lua_gc(L, LUA_GCCOLLECT, 0);
+
+    if (!PR_LoadChunk("qwprogs"))
+        SV_Error("No qwprogs.lua found.");
 
     if (lua_pcall(L, 0, 0, 0) != LUA_OK)
         SV_Error((char *)lua_tostring(L, -1));
@@ -803,9 +1552,170 @@ void PR_LoadProgs(void)
     SpectatorConnect = ED_FindFunction("SpectatorConnect");
     SpectatorThink = ED_FindFunction("SpectatorThink");
     SpectatorDisconnect = ED_FindFunction("SpectatorDisconnect");
+
+    // the globals were reset, wrap the new builtins
+    if (pr_profiling)
+        PR_ProfileRestart();
+
+    Con_DPrintf("PR_LoadProgs: %.1f ms\n", (Sys_DoubleTime() - start) * 1000);
 }
 
 
+/*
+===============
+ED_Bench_f
+
+Times edict field access from Lua with both the linear strcmp lookup and
+the interned key hash.
+
+edictbench [iterations]
+===============
+*/
+static const char *ed_bench_code =
+    "local e, n = ...\n"
+    "local x\n"
+    "for i = 1, n do\n"
+    "    x = e.modelindex\n"         // first C field
+    "    x = e.noise3\n"             // last C field
+    "    x = e.edictbench\n"         // Lua-only field
+    "    e.frags = e.frags\n"
+    "end\n";
+
+static void ED_Bench_f(void)
+{
+    int i, n;
+    double start, t[2];
+
+    if (!L || sv.state == ss_dead) {
+        Con_Printf("edictbench: no map running\n");
+        return;
+    }
+
+    n = 1000000;
+    if (Cmd_Argc() > 1)
+        n = atoi(Cmd_Argv(1));
+    if (n < 1)
+        n = 1;
+
+    for (i = 0; i < 2; i++) {
+        ed_usefieldhash = i;
+
+        if (luaL_loadstring(L, ed_bench_code) != LUA_OK)
+            SV_Error((char *)lua_tostring(L, -1));
+        ED_PushEdict(L, sv.edicts);
+        lua_pushinteger(L, n);
+
+        start = Sys_DoubleTime();
+        if (lua_pcall(L, 2, 0, 0) != LUA_OK)
+            SV_Error((char *)lua_tostring(L, -1));
+        t[i] = Sys_DoubleTime() - start;
+    }
+
+    ed_usefieldhash = true;
+
+    // five field accesses per iteration
+    Con_Printf("%i iterations\n", n);
+    Con_Printf("strcmp chain: %6.1f ns/access\n", t[0] * 1e9 / (n * 5.0));
+    Con_Printf("field hash  : %6.1f ns/access\n", t[1] * 1e9 / (n * 5.0));
+}
+
+/*
+===============
+PR_Bench_f
+
+Times a call reading self, other and time as globals the way
+PR_ExecuteProgram used to make it, pushing all four globals into _G first,
+against PR_ExecuteProgram reading them through pr_global_struct and
+passing them as parameters.
+
+progbench [calls]
+===============
+*/
+static const char *pr_bench_code[2] = {
+    "return function() local x = self, other, time end",
+    "return function(self, other, time) local x = self, other, time end"
+};
+
+static void PR_Bench_f(void)
+{
+    int i, j, n, fn;
+    int oldself, oldother;
+    double start, t[3];
+
+    if (!L || sv.state == ss_dead) {
+        Con_Printf("progbench: no map running\n");
+        return;
+    }
+
+    n = 100000;
+    if (Cmd_Argc() > 1)
+        n = atoi(Cmd_Argv(1));
+    if (n < 1)
+        n = 1;
+
+    oldself = pr_global_struct->self;
+    oldother = pr_global_struct->other;
+    pr_global_struct->self = EDICT_TO_PROG(sv.edicts);
+    pr_global_struct->other = EDICT_TO_PROG(sv.edicts);
+
+    for (i = 0; i < 3; i++) {
+        if (luaL_loadstring(L, pr_bench_code[i == 2]) != LUA_OK
+            || lua_pcall(L, 0, 1, 0) != LUA_OK)
+            SV_Error((char *)lua_tostring(L, -1));
+        fn = PR_RefFunction(L);
+
+        start = Sys_DoubleTime();
+        if (i == 0) {
+            // plain globals, without the pr_global_struct metatable
+            lua_pushglobaltable(L);
+            lua_getmetatable(L, -1);
+            lua_pushnil(L);
+            lua_setmetatable(L, -3);
+
+            for (j = 0; j < n; j++) {
+                lua_rawgeti(L, LUA_REGISTRYINDEX, fn);
+                PUSH_GREF(self);
+                PUSH_GREF(other);
+                PUSH_GFLOAT(force_retouch);
+                PUSH_GFLOAT(time);
+                if (lua_pcall(L, 0, 0, 0) != LUA_OK)
+                    SV_Error((char *)lua_tostring(L, -1));
+            }
+
+            lua_pushnil(L);
+            lua_setglobal(L, "self");
+            lua_pushnil(L);
+            lua_setglobal(L, "other");
+            lua_pushnil(L);
+            lua_setglobal(L, "force_retouch");
+            lua_pushnil(L);
+            lua_setglobal(L, "time");
+            lua_setmetatable(L, -2);
+            lua_pop(L, 1);
+        } else {
+            for (j = 0; j < n; j++)
+                PR_ExecuteProgram(fn);
+        }
+        t[i] = Sys_DoubleTime() - start;
+
+        luaL_unref(L, LUA_REGISTRYINDEX, fn);
+    }
+
+    pr_global_struct->self = oldself;
+    pr_global_struct->other = oldother;
+
+    Con_Printf("%i calls\n", n);
+    Con_Printf("pushed globals: %6.1f ns/call\n", t[0] * 1e9 / n);
+    Con_Printf("engine globals: %6.1f ns/call\n", t[1] * 1e9 / n);
+    Con_Printf("parameters    : %6.1f ns/call\n", t[2] * 1e9 / n);
+    if (svs.stats.latched_progcalls)
+        Con_Printf("%5.2f calls/frame: %6.1f / %6.1f / %6.1f us/frame\n",
+                   (float) svs.stats.latched_progcalls / STATFRAMES,
+                   t[0] * 1e6 / n * svs.stats.latched_progcalls / STATFRAMES,
+                   t[1] * 1e6 / n * svs.stats.latched_progcalls / STATFRAMES,
+                   t[2] * 1e6 / n * svs.stats.latched_progcalls / STATFRAMES);
+}
+
 /*
 ===============
 PR_Init
@@ -814,14 +1724,57 @@ PR_Init
 void PR_Init(void)
 {
     Con_Printf("PR_Init called\n");
+
+    PR_InitAlloc();
+
+    Cmd_AddCommand("edictbench", ED_Bench_f);
+    Cmd_AddCommand("progbench", PR_Bench_f);
+    Cmd_AddCommand("profile", PR_Profile_f);
     /*
     Cmd_AddCommand("edict", ED_PrintEdict_f);
     Cmd_AddCommand("edicts", ED_PrintEdicts);
     Cmd_AddCommand("edictcount", ED_Count);
-    Cmd_AddCommand("profile", PR_Profile_f);
     */
 }
 
+/*
+====================
+PR_RefFunction
+
+luaL_ref for functions PR_ExecuteProgram may call.  Whether the function
+takes parameters is looked up once here instead of on every call.
+====================
+*/
+int PR_RefFunction(lua_State *L)
+{
+    lua_Debug ar;
+    int ref, n;
+
+    ar.nparams = 0;
+    if (lua_isfunction(L, -1)) {
+        lua_pushvalue(L, -1);
+        lua_getinfo(L, ">u", &ar);
+    }
+
+    ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    if (ref <= 0)
+        return ref;
+
+    if (ref >= pr_numfnparams) {
+        n = pr_numfnparams ? pr_numfnparams : 1024;
+        while (n <= ref)
+            n *= 2;
+        pr_fnparams = realloc(pr_fnparams, n);
+        if (!pr_fnparams)
+            Sys_Error("PR_RefFunction: out of memory");
+        memset(pr_fnparams + pr_numfnparams, 0, n - pr_numfnparams);
+        pr_numfnparams = n;
+    }
+    pr_fnparams[ref] = ar.nparams > 0;
+
+    return ref;
+}
+
 /*
 ====================
 PR_ExecuteProgram
@@ -829,6 +1782,8 @@ PR_ExecuteProgram
 */
 void PR_ExecuteProgram(func_t fnum)
 {
+    int nargs;
+
     // if thinking without a valid function, we still get called
     if (fnum == 0)
         return;
@@ -849,7 +1804,7 @@ void PR_ExecuteProgram(func_t fnum)
         pr_global_struct->world = EDICT_NUM(0)->ref;
 
         PUSH_GREF(world);
-        PUSH_GREF(mapname);
+        PUSH_GSTRING(mapname);
         PUSH_GFLOAT(serverflags);
 
         // push them but we ignore the values for now
@@ -859,20 +1814,24 @@ void PR_ExecuteProgram(func_t fnum)
         PUSH_GFLOAT(killed_monsters);
     }
 
-    if (fnum == pr_global_struct->StartFrame) {
-        GET_GFLOAT(force_retouch); // this should be fine
-    }
-
     if (pr_global_struct->self == 0)
         SV_Error("Executing a function with zero self, this is a bug.\n");
 
-    // self and other always need to be pushed but they should be params
-    PUSH_GREF(self);
-    PUSH_GREF(other);
-    // pushing this improves frame efficiency by around 34% on Ryzen
-    PUSH_GFLOAT(force_retouch);
-    // time needs to be pushed for accuracy
-    PUSH_GFLOAT(time);
+    if (pr_profiling)
+        PR_ProfileEnter(L);
+
+    // self, other and time need no pushing, the globals read
+    // pr_global_struct.  Functions that take parameters get them as
+    // arguments as well
+    nargs = 0;
+    if (fnum < pr_numfnparams && pr_fnparams[fnum]) {
+        PUSH_GARG(self);
+        PUSH_GARG(other);
+        lua_pushnumber(L, pr_global_struct->time);
+        nargs = 3;
+    }
+
+    svs.stats.progcalls++;
 
     if (fnum == pr_global_struct->PutClientInServer) {
         PUSH_GFLOAT(parm1);
@@ -886,9 +1845,12 @@ void PR_ExecuteProgram(func_t fnum)
         PUSH_GFLOAT(parm9);
     }
 
-    if (lua_pcall(L, 0, 0, 0) != LUA_OK)
+    if (lua_pcall(L, nargs, 0, 0) != LUA_OK)
         SV_Error((char *)lua_tostring(L, -1));
 
+    if (pr_profiling)
+        PR_ProfileLeave(L);
+
     if (fnum == pr_global_struct->SetChangeParms || fnum == pr_global_struct->SetNewParms) {
         GET_GFLOAT(parm1);
         GET_GFLOAT(parm2);
@@ -921,39 +1883,229 @@ int NUM_FOR_EDICT(edict_t * e)
     return b;
 }
 
-char *PR_GetString(int num)
+/*
+=============================================================================
+
+STRING TABLE
+
+string_t is an index into a table of interned strings.  Each string_t
+stored in an edict field holds a reference, taken by PR_SetString and
+dropped with PR_FreeString when the field is overwritten or the edict is
+cleared or freed, so the text of a string that is no longer stored
+anywhere goes away and its handle is reused.  PR_StrDup strings are never
+released and last until the next level.  The text is malloced, strings
+come and go with every client name.  The Lua copy of a string is
+created the first time it's pushed and kept as a registry ref.
+
+=============================================================================
+*/
+
+#define PRSTR_HASH  1024        // power of two
+
+typedef struct {
+    char *s;
+    int refs;                   // string_t copies stored, 0 when free
+    int ref;                    // Lua string in the registry
+    int next;                   // hash chain, or free list
+} prstr_t;
+
+static prstr_t pr_strtbl[MAX_PRSTR];
+static int pr_strhash[PRSTR_HASH];
+static int pr_strfree;          // first released handle
+
+static unsigned PR_HashString(const char *s)
 {
-    static char buf[256];
+    unsigned h;
 
-    if (num == 0)
-        return "";
+    for (h = 0; *s; s++)
+        h = h * 31 + (byte)*s;
+
+    return h & (PRSTR_HASH - 1);
+}
 
-    lua_rawgeti(L, LUA_REGISTRYINDEX, num);
+/*
+=============
+PR_ClearStrings
 
-    snprintf(buf, sizeof(buf), "%s", luaL_checkstring(L, -1));
+Called for every new level
+=============
+*/
+void PR_ClearStrings(void)
+{
+    int i;
 
-    lua_pop(L, 1);
+    for (i = 1; i < num_prstr; i++) {
+        if (pr_strtbl[i].ref > 0)
+            luaL_unref(L, LUA_REGISTRYINDEX, pr_strtbl[i].ref);
+        free(pr_strtbl[i].s);
+    }
 
-    //Con_Printf("PR_GetString(%d) -> '%s'\n", num, buf);
+    memset(pr_strtbl, 0, sizeof(pr_strtbl));
+    memset(pr_strhash, 0, sizeof(pr_strhash));
+    pr_strfree = 0;
 
-    return buf;
+    // string_t 0 reads as "" from C and as nil from Lua
+    pr_strtbl[0].s = "";
+    num_prstr = 1;
 }
 
+char *PR_GetString(int num)
+{
+    if (num < 0 || num >= num_prstr || !pr_strtbl[num].s)
+        SV_Error("PR_GetString: bad string %d", num);
+
+    return pr_strtbl[num].s;
+}
+
+/*
+=============
+PR_FindString
+
+Returns the handle of an already interned string, or 0
+=============
+*/
+int PR_FindString(const char *s)
+{
+    int i;
+
+    for (i = pr_strhash[PR_HashString(s)]; i; i = pr_strtbl[i].next)
+        if (!strcmp(pr_strtbl[i].s, s))
+            return i;
+
+    return 0;
+}
+
+/*
+=============
+PR_SetString
+
+Returns a handle to s with a new reference for the caller to store.  If
+the table is full the string is dropped and 0 ("") returned.
+=============
+*/
 int PR_SetString(char *s)
 {
-    lua_pushstring(L, s);
-    return luaL_ref(L, LUA_REGISTRYINDEX);
+    static qboolean warned;
+    prstr_t *str;
+    unsigned h;
+    char *copy;
+    int i;
+
+    if ((i = PR_FindString(s))) {
+        pr_strtbl[i].refs++;
+        return i;
+    }
+
+    h = PR_HashString(s);
+
+    if (pr_strfree)
+        i = pr_strfree;
+    else if (num_prstr < MAX_PRSTR)
+        i = num_prstr;
+    else
+        i = 0;
+
+    copy = i ? malloc(strlen(s) + 1) : NULL;
+    if (!copy) {
+        if (!warned)
+            Con_Printf("PR_SetString: out of string space, dropping "
+                       "\"%s\"\n", s);
+        warned = true;
+        return 0;
+    }
+    warned = false;
+
+    if (i == pr_strfree)
+        pr_strfree = pr_strtbl[i].next;
+    else
+        num_prstr++;
+
+    str = &pr_strtbl[i];
+    str->s = copy;
+    strcpy(str->s, s);
+    str->refs = 1;
+    str->ref = 0;
+    str->next = pr_strhash[h];
+    pr_strhash[h] = i;
+
+    return i;
 }
 
-// XXX: these are *never* freed at this point
-char *PR_StrDup(const char *in)
+/*
+=============
+PR_FreeString
+
+Drops a reference taken by PR_SetString
+=============
+*/
+void PR_FreeString(int num)
 {
-    char *out;
+    prstr_t *str;
+    int *link;
+
+    if (num <= 0 || num >= num_prstr)
+        return;
+
+    str = &pr_strtbl[num];
+    if (!str->refs || --str->refs)
+        return;
+
+    for (link = &pr_strhash[PR_HashString(str->s)]; *link;
+         link = &pr_strtbl[*link].next)
+        if (*link == num) {
+            *link = str->next;
+            break;
+        }
 
-    out = Z_Malloc(strlen(in) + 1);
-    strcpy(out, in);
+    if (str->ref > 0)
+        luaL_unref(L, LUA_REGISTRYINDEX, str->ref);
+    free(str->s);
 
-    return out;
+    str->s = NULL;
+    str->ref = 0;
+    str->next = pr_strfree;
+    pr_strfree = num;
+}
+
+/*
+=============
+PR_ReplaceString
+
+Stores a handle to s (NULL for none) in field, releasing the old one
+=============
+*/
+void PR_ReplaceString(string_t * field, char *s)
+{
+    string_t old;
+
+    old = *field;
+    *field = s ? PR_SetString(s) : 0;
+    PR_FreeString(old);
+}
+
+void PR_PushString(lua_State *L, int num)
+{
+    prstr_t *str;
+
+    if (num == 0) {
+        lua_pushnil(L);
+        return;
+    }
+
+    str = &pr_strtbl[num];
+
+    if (!str->ref) {
+        lua_pushstring(L, str->s);
+        str->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    }
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, str->ref);
+}
+
+// the copy lives until the next level
+char *PR_StrDup(const char *in)
+{
+    return PR_GetString(PR_SetString((char *)in));
 }
 
 edict_t *PROG_TO_EDICT(int ref)
@@ -0,0 +1,394 @@
+// lua_profile.c -- sampling profiler for the game code
+
+/*
+   a count hook samples the Lua stack every pr_profilecount VM instructions
+   and charges the time since the previous sample to it.  no instructions
+   run while a builtin is busy, so while profiling the global C functions
+   are wrapped to take a sample on the way in and out, which charges their
+   time to a stack ending in the builtin itself.
+
+   samples are kept twice: by full stack for flamegraphs and by the function
+   and line they landed on for the flat profile.
+*/
+
+#include "qwsvdef.h"
+
+extern lua_State *L;
+
+#define PROF_KEYLEN     256
+#define PROF_DEPTH      32
+#define MAX_PROF_STACKS 2048    // power of two
+#define MAX_PROF_FLAT   1024    // power of two
+#define MAX_PROF_CFUNCS 256
+
+typedef struct {
+    char key[PROF_KEYLEN];
+    double time;
+    int samples;
+} profentry_t;
+
+qboolean pr_profiling;
+
+static int pr_profilecount = 1000;
+static double pr_profilestart, pr_profiletime;
+static double pr_lastsample;
+static int pr_dropped;
+
+static profentry_t pr_profstacks[MAX_PROF_STACKS];
+static profentry_t pr_profflat[MAX_PROF_FLAT];
+
+static lua_CFunction pr_cfuncs[MAX_PROF_CFUNCS];
+static int pr_numcfuncs;
+
+// roots of the PR_ExecuteProgram calls in progress
+static char pr_roots[PROF_DEPTH][PROF_KEYLEN];
+static int pr_depth;
+
+static profentry_t *PR_ProfileEntry(profentry_t *table, int size, const char *key)
+{
+    unsigned h;
+    const char *s;
+    int i;
+
+    for (h = 0, s = key; *s; s++)
+        h = h * 31 + (byte)*s;
+
+    for (i = 0; i < size; i++) {
+        h &= size - 1;
+        if (!table[h].key[0]) {
+            snprintf(table[h].key, PROF_KEYLEN, "%s", key);
+            return &table[h];
+        }
+        if (!strcmp(table[h].key, key))
+            return &table[h];
+        h++;
+    }
+
+    pr_dropped++;
+    return NULL;
+}
+
+static void PR_ProfileCharge(const char *stack, const char *leaf, double dt)
+{
+    profentry_t *e;
+
+    if ((e = PR_ProfileEntry(pr_profstacks, MAX_PROF_STACKS, stack))) {
+        e->time += dt;
+        e->samples++;
+    }
+    if ((e = PR_ProfileEntry(pr_profflat, MAX_PROF_FLAT, leaf))) {
+        e->time += dt;
+        e->samples++;
+    }
+}
+
+/*
+=================
+PR_ProfileSample
+
+Charges the time since the last sample to the current stack
+=================
+*/
+static void PR_ProfileSample(lua_State *L)
+{
+    static char frames[PROF_DEPTH][PROF_KEYLEN];
+    char stack[PROF_KEYLEN * 2], leaf[PROF_KEYLEN];
+    lua_Debug ar;
+    double now, dt;
+    int i, n, len;
+
+    now = Sys_DoubleTime();
+    dt = now - pr_lastsample;
+    pr_lastsample = now;
+
+    leaf[0] = 0;
+    for (n = 0; n < PROF_DEPTH && lua_getstack(L, n, &ar); n++) {
+        lua_getinfo(L, "Snl", &ar);
+        if (*ar.what == 'C')
+            snprintf(frames[n], PROF_KEYLEN, "%s", ar.name ? ar.name : "?");
+        else
+            snprintf(frames[n], PROF_KEYLEN, "%s@%s:%i",
+                     ar.name ? ar.name : "?", ar.short_src, ar.linedefined);
+        if (n == 0 && *ar.what != 'C')
+            snprintf(leaf, sizeof(leaf), "%s@%s:%i",
+                     ar.name ? ar.name : "?", ar.short_src, ar.currentline);
+        else if (n == 0)
+            snprintf(leaf, sizeof(leaf), "%s", frames[0]);
+    }
+
+    // outermost first, the way flamegraph.pl wants it
+    stack[0] = 0;
+    len = 0;
+    if (pr_depth > 0 && n == 0) {
+        // between Lua frames of a nested call, charge its root
+        len = snprintf(stack, sizeof(stack), "%s", pr_roots[pr_depth - 1]);
+        snprintf(leaf, sizeof(leaf), "%s", pr_roots[pr_depth - 1]);
+    }
+    for (i = n - 1; i >= 0 && len < (int) sizeof(stack); i--)
+        len += snprintf(stack + len, sizeof(stack) - len, "%s%s",
+                        len ? ";" : "", frames[i]);
+
+    PR_ProfileCharge(stack, leaf, dt);
+}
+
+static void PR_ProfileHook(lua_State *L, lua_Debug *ar)
+{
+    PR_ProfileSample(L);
+}
+
+static int PR_ProfiledBuiltin(lua_State *L)
+{
+    lua_CFunction f;
+    int n;
+
+    f = pr_cfuncs[lua_tointeger(L, lua_upvalueindex(1))];
+
+    // up to here the caller was running
+    PR_ProfileSample(L);
+
+    n = f(L);
+
+    // the stack now ends in this wrapper, named after the builtin
+    PR_ProfileSample(L);
+
+    return n;
+}
+
+/*
+=================
+PR_ProfileWrap
+
+Swaps the global C functions for PR_ProfiledBuiltin closures and back
+=================
+*/
+static void PR_ProfileWrap(qboolean wrap)
+{
+    lua_CFunction f;
+    int i;
+
+    lua_pushglobaltable(L);
+    lua_pushnil(L);
+    while (lua_next(L, -2)) {
+        f = lua_iscfunction(L, -1) ? lua_tocfunction(L, -1) : NULL;
+
+        if (f == PR_ProfiledBuiltin) {
+            if (!wrap) {
+                lua_getupvalue(L, -1, 1);
+                i = lua_tointeger(L, -1);
+                lua_pop(L, 1);
+                lua_pushvalue(L, -2);
+                lua_pushcfunction(L, pr_cfuncs[i]);
+                lua_rawset(L, -5);
+            }
+        } else if (f && wrap && pr_numcfuncs < MAX_PROF_CFUNCS) {
+            // C closures would lose their upvalues, leave them alone
+            if (lua_getupvalue(L, -1, 1)) {
+                lua_pop(L, 1);
+            } else {
+                pr_cfuncs[pr_numcfuncs] = f;
+                lua_pushvalue(L, -2);
+                lua_pushinteger(L, pr_numcfuncs++);
+                lua_pushcclosure(L, PR_ProfiledBuiltin, 1);
+                lua_rawset(L, -5);
+            }
+        }
+
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+
+    if (!wrap)
+        pr_numcfuncs = 0;
+}
+
+/*
+=================
+PR_ProfileEnter
+
+Called by PR_ExecuteProgram with the function on top of the stack
+=================
+*/
+void PR_ProfileEnter(lua_State *L)
+{
+    lua_Debug ar;
+
+    if (pr_depth > 0)
+        PR_ProfileSample(L);
+    else
+        pr_lastsample = Sys_DoubleTime();
+
+    if (pr_depth == PROF_DEPTH) {
+        pr_depth++;
+        return;
+    }
+
+    lua_pushvalue(L, -1);
+    lua_getinfo(L, ">S", &ar);
+    snprintf(pr_roots[pr_depth], PROF_KEYLEN, "?@%s:%i", ar.short_src,
+             ar.linedefined);
+    pr_depth++;
+}
+
+/*
+=================
+PR_ProfileLeave
+
+Charges the rest of the call to its root function
+=================
+*/
+void PR_ProfileLeave(lua_State *L)
+{
+    if (pr_depth <= PROF_DEPTH)
+        PR_ProfileSample(L);
+    pr_depth--;
+}
+
+/*
+=================
+PR_ProfileRestart
+
+Called when the globals were reset for a new level
+=================
+*/
+void PR_ProfileRestart(void)
+{
+    pr_depth = 0;
+    pr_numcfuncs = 0;
+    PR_ProfileWrap(true);
+}
+
+static int PR_CompareProfile(const void *a, const void *b)
+{
+    double d = (*(profentry_t **)b)->time - (*(profentry_t **)a)->time;
+
+    return d < 0 ? -1 : d > 0;
+}
+
+static void PR_ProfileClear(void)
+{
+    memset(pr_profstacks, 0, sizeof(pr_profstacks));
+    memset(pr_profflat, 0, sizeof(pr_profflat));
+    pr_dropped = 0;
+    pr_profiletime = 0;
+    pr_profilestart = Sys_DoubleTime();
+}
+
+static void PR_ProfileStart(int count)
+{
+    if (pr_profiling)
+        return;
+
+    pr_depth = 0;
+    pr_profilecount = count;
+    PR_ProfileWrap(true);
+    lua_sethook(L, PR_ProfileHook, LUA_MASKCOUNT, pr_profilecount);
+    pr_profilestart = Sys_DoubleTime();
+    pr_profiling = true;
+}
+
+static void PR_ProfileStop(void)
+{
+    if (!pr_profiling)
+        return;
+
+    lua_sethook(L, NULL, 0, 0);
+    PR_ProfileWrap(false);
+    pr_profiletime += Sys_DoubleTime() - pr_profilestart;
+    pr_profiling = false;
+}
+
+static void PR_ProfileFlat(int count)
+{
+    static profentry_t *sorted[MAX_PROF_FLAT];
+    double total, elapsed;
+    int i, n;
+
+    total = 0;
+    for (i = n = 0; i < MAX_PROF_FLAT; i++) {
+        if (!pr_profflat[i].key[0])
+            continue;
+        sorted[n++] = &pr_profflat[i];
+        total += pr_profflat[i].time;
+    }
+    qsort(sorted, n, sizeof(sorted[0]), PR_CompareProfile);
+
+    elapsed = pr_profiletime;
+    if (pr_profiling)
+        elapsed += Sys_DoubleTime() - pr_profilestart;
+
+    Con_Printf("%.1f ms in progs over %.1f s, %i dropped\n", total * 1000,
+               elapsed, pr_dropped);
+    Con_Printf("    ms      %%  samples  function@source:line\n");
+    for (i = 0; i < n && i < count; i++)
+        Con_Printf("%8.2f %6.2f %8i  %s\n", sorted[i]->time * 1000,
+                   total ? 100 * sorted[i]->time / total : 0,
+                   sorted[i]->samples, sorted[i]->key);
+}
+
+static void PR_ProfileStacks(char *name)
+{
+    char *path;
+    FILE *f;
+    int i;
+
+    path = va("%s/%s", com_gamedir, name);
+    COM_CreatePath(path);
+
+    f = fopen(path, "w");
+    if (!f) {
+        Con_Printf("Couldn't write %s\n", path);
+        return;
+    }
+
+    // values are in microseconds
+    for (i = 0; i < MAX_PROF_STACKS; i++)
+        if (pr_profstacks[i].key[0])
+            fprintf(f, "%s %i\n", pr_profstacks[i].key,
+                    (int) (pr_profstacks[i].time * 1e6 + 0.5));
+
+    fclose(f);
+    Con_Printf("Wrote %s\n", path);
+}
+
+/*
+=================
+PR_Profile_f
+
+profile start [count] | stop | clear | flat [lines] | stacks [file]
+=================
+*/
+void PR_Profile_f(void)
+{
+    char *cmd;
+    int count;
+
+    if (!L) {
+        Con_Printf("profile: no progs loaded\n");
+        return;
+    }
+
+    cmd = Cmd_Argc() > 1 ? Cmd_Argv(1) : "flat";
+
+    if (!strcmp(cmd, "start")) {
+        if (pr_profiling) {
+            Con_Printf("Already profiling every %i instructions, "
+                       "stop first\n", pr_profilecount);
+            return;
+        }
+        PR_ProfileClear();
+        count = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 1000;
+        PR_ProfileStart(count < 1 ? 1 : count);
+        Con_Printf("Profiling every %i instructions\n", pr_profilecount);
+    } else if (!strcmp(cmd, "stop")) {
+        PR_ProfileStop();
+    } else if (!strcmp(cmd, "clear")) {
+        PR_ProfileClear();
+    } else if (!strcmp(cmd, "flat")) {
+        PR_ProfileFlat(Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 20);
+    } else if (!strcmp(cmd, "stacks")) {
+        PR_ProfileStacks(Cmd_Argc() > 2 ? Cmd_Argv(2) : "profile.folded");
+    } else {
+        Con_Printf("profile start [count] | stop | clear | flat [lines] | "
+                   "stacks [file]\n");
+    }
+}
@@ -22,6 +22,7 @@ typedef int func_t;
 typedef int string_t;
 
 struct edict_s;
+struct trace_s;
 
 #include "progdefs.h"
 
@@ -37,6 +38,11 @@ typedef struct {
 } ddef_t;
 
 #define	MAX_ENT_LEAFS	16
+#define	NUM_ED_VECTORS	13      // vec3_t fields in entvars_t
+
+#define	ED_INDEX_CLASSNAME	0
+#define	ED_INDEX_TARGETNAME	1
+#define	NUM_ED_INDEXES	2
 typedef struct edict_s {
     qboolean free;
     link_t area;                // linked to a division node or leaf
@@ -46,10 +52,19 @@ typedef struct edict_s {
 
     entity_state_t baseline;
 
+    int netdirty;               // ND_* bits changed during netframe
+    int netframe;               // sv_netframe of the last change
+
     float freetime;             // sv.time when the object was freed
     entvars_t v;                // C exported fields from progs
     int ref;                    // Lua self reference
     int fields;                 // Lua fields table ref
+    int views[NUM_ED_VECTORS];  // cached vec3_t views of v's vectors
+
+    // string indexes, see ED_Index
+    string_t indexkey[NUM_ED_INDEXES];
+    struct edict_s *indexnext[NUM_ED_INDEXES];
+    struct edict_s *indexprev[NUM_ED_INDEXES];
 } edict_t;
 
 //============================================================================
@@ -58,15 +73,26 @@ void PR_Init(void);
 void PR_InstallBuiltins(void);
 
 void PR_ExecuteProgram(func_t fnum);
+int PR_RefFunction(lua_State *L);
 void PR_LoadProgs(void);
+void PR_ClearLevel(void);
 
 void PR_Profile_f(void);
-char *PR_StrDup(const char *); // XXX: this needs to be fixed
+void PR_ProfileEnter(lua_State *L);
+void PR_ProfileLeave(lua_State *L);
+void PR_ProfileRestart(void);
+extern qboolean pr_profiling;
+char *PR_StrDup(const char *); // lives until the next level
 
 edict_t *ED_Alloc(void);
 void ED_Free(edict_t * ed);
+void ED_ClearVars(edict_t * ed);
 void ED_PushEdict(edict_t *ed);
 
+void ED_Index(edict_t * ed, int index, string_t key);
+edict_t *ED_FindIndexed(int index, string_t key, edict_t * start);
+void ED_VectorWritten(vec_t *v);
+
 void ED_Print(edict_t * ed);
 char *ED_ParseEdict(char *data, edict_t * ent);
 void ED_LoadFromFile(char *data);
@@ -105,10 +131,15 @@ eval_t *GetEdictFieldValue(edict_t * ed, char *field);
 //
 // PR Strings stuff
 //
-#define MAX_PRSTR 1024
+#define MAX_PRSTR 4096
 
+void PR_ClearStrings(void);
 char *PR_GetString(int num);
 int PR_SetString(char *s);
+void PR_FreeString(int num);
+void PR_ReplaceString(string_t * field, char *s);
+int PR_FindString(const char *s);
+void PR_PushString(lua_State *L, int num);
 
 //
 // compatibility with the engine as it is
@@ -145,7 +176,14 @@ extern int num_prstr;
     if (strcmp(key, #n) == 0) { e->v.n = atof(value); return true; }
 
 #define FIELD_STRING(n) \
-    if (strcmp(key, #n) == 0) { lua_pushstring(L, value); e->v.n = luaL_ref(L, LUA_REGISTRYINDEX); return true; }
+    if (strcmp(key, #n) == 0) { PR_ReplaceString(&e->v.n, value); return true; }
+
+#define FIELD_INDEXED(n, i) \
+    if (strcmp(key, #n) == 0) { \
+        PR_ReplaceString(&e->v.n, value); \
+        ED_Index(e, i, e->v.n); \
+        return true; \
+    }
 
 #define FIELD_VEC(n) \
     if (strcmp(key, #n) == 0) { \
@@ -161,6 +199,16 @@ extern int num_prstr;
         lua_pushnil(L); \
     lua_setglobal(L, #s);
 
+#define PUSH_GARG(s) \
+    if (pr_global_struct->s) \
+        lua_rawgeti(L, LUA_REGISTRYINDEX, pr_global_struct->s); \
+    else \
+        lua_pushnil(L);
+
+#define PUSH_GSTRING(s) \
+    PR_PushString(L, pr_global_struct->s); \
+    lua_setglobal(L, #s);
+
 #define PUSH_GFLOAT(s) \
     lua_pushnumber(L, pr_global_struct->s); \
     lua_setglobal(L, #s);
@@ -181,3 +229,11 @@ void PR_Vec3_Init(lua_State *L);
 vec_t* PR_Vec3_New(lua_State *L);
 vec_t* PR_Vec3_ToVec(lua_State *L, int index);
 void PR_Vec3_Push(lua_State *L, vec3_t in);
+void PR_Vec3_PushView(lua_State *L, vec3_t in, int *ref);
+
+void PR_InitAlloc(void);
+void *PR_Alloc(void *ud, void *ptr, size_t osize, size_t nsize);
+void PR_StepGC(double budget);
+
+void PR_Trace_Init(lua_State *L);
+struct trace_s* PR_Trace_Push(lua_State *L, int index);
@@ -0,0 +1,155 @@
+// lua_trace.c -- trace_t management
+
+/*
+   traceline results are trace_t userdata and fields are read straight from
+   the C struct.  endpos, plane and plane.normal are views into the userdata,
+   created on first read and cached in its user value, so a result passed
+   back into traceline is refilled without allocating anything.
+
+   the views hold the trace in their own user value so it can't be
+   collected while they are still around.
+*/
+
+#include "qwsvdef.h"
+
+// pushes the cache table of the trace at index
+static void PR_Trace_PushCache(lua_State *L, int index)
+{
+    if (lua_getuservalue(L, index) == LUA_TTABLE)
+        return;
+
+    lua_pop(L, 1);
+    lua_createtable(L, 0, 3);
+    lua_pushvalue(L, -1);
+    lua_setuservalue(L, index);
+}
+
+// pushes a cached vec3_t view of v, which lives in the trace at index
+static void PR_Trace_PushVec(lua_State *L, int index, const char *name, vec_t *v)
+{
+    index = lua_absindex(L, index);
+    PR_Trace_PushCache(L, index);
+
+    if (lua_getfield(L, -1, name) == LUA_TNIL) {
+        lua_pop(L, 1);
+        PR_Vec3_Push(L, v);
+        lua_pushvalue(L, index);
+        lua_setuservalue(L, -2);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, -3, name);
+    }
+
+    lua_remove(L, -2);
+}
+
+static int PR_Plane_Index(lua_State *L)
+{
+    trace_t **t;
+    const char *key;
+
+    t = luaL_checkudata(L, 1, "plane_t");
+    key = luaL_checkstring(L, 2);
+
+    if (!strcmp(key, "dist")) {
+        lua_pushnumber(L, (*t)->plane.dist);
+    } else if (!strcmp(key, "normal")) {
+        lua_getuservalue(L, 1);
+        PR_Trace_PushVec(L, -1, "normal", (*t)->plane.normal);
+        lua_remove(L, -2);
+    } else {
+        lua_pushnil(L);
+    }
+
+    return 1;
+}
+
+static int PR_Trace_Index(lua_State *L)
+{
+    trace_t *t, **p;
+    const char *key;
+
+    t = luaL_checkudata(L, 1, "trace_t");
+    key = luaL_checkstring(L, 2);
+
+    if (!strcmp(key, "fraction")) {
+        lua_pushnumber(L, t->fraction);
+    } else if (!strcmp(key, "ent")) {
+        if (t->ent) {
+            ED_PushEdict(L, t->ent);
+        } else {
+            lua_pushnil(L);
+        }
+    } else if (!strcmp(key, "endpos")) {
+        PR_Trace_PushVec(L, 1, "endpos", t->endpos);
+    } else if (!strcmp(key, "plane")) {
+        PR_Trace_PushCache(L, 1);
+        if (lua_getfield(L, -1, "plane") == LUA_TNIL) {
+            lua_pop(L, 1);
+            p = lua_newuserdata(L, sizeof(*p));
+            *p = t;
+            luaL_getmetatable(L, "plane_t");
+            lua_setmetatable(L, -2);
+            lua_pushvalue(L, 1);
+            lua_setuservalue(L, -2);
+            lua_pushvalue(L, -1);
+            lua_setfield(L, -3, "plane");
+        }
+        lua_remove(L, -2);
+    } else if (!strcmp(key, "allsolid")) {
+        lua_pushboolean(L, t->allsolid);
+    } else if (!strcmp(key, "startsolid")) {
+        lua_pushboolean(L, t->startsolid);
+    } else if (!strcmp(key, "inopen")) {
+        lua_pushboolean(L, t->inopen);
+    } else if (!strcmp(key, "inwater")) {
+        lua_pushboolean(L, t->inwater);
+    } else {
+        lua_pushnil(L);
+    }
+
+    return 1;
+}
+
+static const luaL_Reg PR_Trace_Metatable[] = {
+    {"__index",    PR_Trace_Index},
+    {0, 0}
+};
+
+static const luaL_Reg PR_Plane_Metatable[] = {
+    {"__index",    PR_Plane_Index},
+    {0, 0}
+};
+
+void PR_Trace_Init(lua_State *L)
+{
+    luaL_newmetatable(L, "trace_t");
+    luaL_setfuncs(L, PR_Trace_Metatable, 0);
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, "plane_t");
+    luaL_setfuncs(L, PR_Plane_Metatable, 0);
+    lua_pop(L, 1);
+}
+
+/*
+   returns the trace_t to fill in, which is left on the stack: the one at
+   index if it is a trace_t, otherwise a new one
+*/
+trace_t* PR_Trace_Push(lua_State *L, int index)
+{
+    trace_t *t;
+
+    if (!lua_isnoneornil(L, index)) {
+        t = luaL_checkudata(L, index, "trace_t");
+        lua_pushvalue(L, index);
+        return t;
+    }
+
+    t = lua_newuserdata(L, sizeof(*t));
+    memset(t, 0, sizeof(*t));
+
+    luaL_getmetatable(L, "trace_t");
+    lua_setmetatable(L, -2);
+
+    return t;
+}
@@ -147,6 +147,8 @@ static int PR_Vec3_NewIndex(lua_State *L)
         default: luaL_error(L, "vec3_t can only have x/y/z");
     }
 
+    ED_VectorWritten(v);
+
     return 0;
 }
 
@@ -175,6 +177,7 @@ vec_t* PR_Vec3_New(lua_State *L)
 
     v = lua_newuserdata(L, sizeof(*v));
     memset(v, 0, sizeof(*v)); // needed?
+    svs.stats.vec3allocs++;
 
     v->p = v->v;
 
@@ -198,9 +201,26 @@ void PR_Vec3_Push(lua_State *L, vec3_t in)
     vec_t **v;
 
     v = lua_newuserdata(L, sizeof(*v));
+    svs.stats.vec3allocs++;
 
     *v = in;
 
     luaL_getmetatable(L, "vec3_t");
     lua_setmetatable(L, -2);
 }
+
+/*
+   views alias storage owned by C (edict fields) and are created only once,
+   the registry ref in *ref keeps them around for the next read
+*/
+void PR_Vec3_PushView(lua_State *L, vec3_t in, int *ref)
+{
+    if (*ref) {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, *ref);
+        return;
+    }
+
+    PR_Vec3_Push(L, in);
+    lua_pushvalue(L, -1);
+    *ref = luaL_ref(L, LUA_REGISTRYINDEX);
+}
@@ -89,7 +89,8 @@ Mod_DecompressVis
 */
 byte *Mod_DecompressVis(byte * in, model_t * model)
 {
-    static byte decompressed[MAX_MAP_LEAFS / 8];
+    // SV_FatPVS runs on the pool threads
+    static THREADLOCAL byte decompressed[MAX_MAP_LEAFS / 8];
     int c;
     byte *out;
     int row;
@@ -899,6 +900,311 @@ void Mod_MakeHull0(void)
     }
 }
 
+/*
+==============================================================================
+
+PACKED HULLS
+
+Traces chase clipnode children through the hull and a plane per node from
+another array, both in the order the map compiler wrote them.  With
+sv_hullnodes set, loading a map also makes a copy of each clipnode array
+with the planes inlined, every tree laid out depth first from its head so
+the front child of a node is the next one in memory.  Mod_TraceHull walks
+that copy with an explicit stack instead of recursing.  The dclipnode_t
+arrays stay as they were for everything else.
+
+==============================================================================
+*/
+
+cvar_t sv_hullnodes = { "sv_hullnodes", "1" };
+
+#define	DIST_EPSILON	(0.03125)       // same as the recursive checks
+#define	MAX_HULLSPLITS	256
+
+static int *mod_renumber[2];    // hull 0 and hulls 1 and 2, while loading
+
+/*
+=================
+Mod_PackHull
+
+Copies count clipnodes from in to out, renumber gets the new number of
+each.  Returns false if a head, child or plane number is bad, the
+recursive code will complain about those if a trace ever gets there.
+=================
+*/
+static qboolean Mod_PackHull(hullnode_t * out, dclipnode_t * in, int count,
+                             int firsthull, int lasthull, int *renumber,
+                             int *stack)
+{
+    dclipnode_t *node;
+    mplane_t *plane;
+    int i, j, h, num, next, sp;
+
+    for (i = 0; i < count; i++) {
+        if (in[i].planenum < 0 || in[i].planenum >= loadmodel->numplanes)
+            return false;
+        for (j = 0; j < 2; j++)
+            if (in[i].children[j] >= count)
+                return false;
+        renumber[i] = -1;
+    }
+    for (i = 0; i < loadmodel->numsubmodels; i++)
+        for (h = firsthull; h <= lasthull; h++)
+            if (loadmodel->submodels[i].headnode[h] < 0
+                || loadmodel->submodels[i].headnode[h] >= count)
+                return false;
+
+    // number the nodes depth first from every head, then whatever no
+    // head reaches in file order
+    next = 0;
+    for (i = 0; i < loadmodel->numsubmodels + count; i++) {
+        sp = 0;
+        if (i < loadmodel->numsubmodels) {
+            for (h = lasthull; h >= firsthull; h--)
+                stack[sp++] = loadmodel->submodels[i].headnode[h];
+        } else
+            stack[sp++] = i - loadmodel->numsubmodels;
+
+        while (sp) {
+            num = stack[--sp];
+            if (num < 0 || renumber[num] != -1)
+                continue;
+            renumber[num] = next++;
+            stack[sp++] = in[num].children[1];
+            stack[sp++] = in[num].children[0];
+        }
+    }
+
+    for (i = 0, node = in; i < count; i++, node++) {
+        plane = loadmodel->planes + node->planenum;
+        num = renumber[i];
+
+        VectorCopy(plane->normal, out[num].normal);
+        out[num].dist = plane->dist;
+        out[num].type = plane->type;
+        for (j = 0; j < 2; j++)
+            out[num].children[j] = node->children[j] < 0 ?
+                node->children[j] : renumber[node->children[j]];
+    }
+
+    return true;
+}
+
+/*
+=================
+Mod_PackHulls
+
+Returns the hunk mark to drop the renumbering at, once the submodels
+have their head nodes
+=================
+*/
+static int Mod_PackHulls(void)
+{
+    hullnode_t *nodes[2];
+    int i, mark, size, *stack;
+
+    for (i = 0; i < MAX_MAP_HULLS; i++)
+        loadmodel->hulls[i].nodes = NULL;
+    mod_renumber[0] = mod_renumber[1] = NULL;
+
+    if (!sv_hullnodes.value)
+        return Hunk_LowMark();
+
+    nodes[0] = Hunk_AllocName(loadmodel->numnodes * sizeof(hullnode_t),
+                              loadname);
+    nodes[1] = Hunk_AllocName(loadmodel->numclipnodes * sizeof(hullnode_t),
+                              loadname);
+
+    mark = Hunk_LowMark();
+
+    // a node is pushed at most twice, plus the heads
+    size = loadmodel->numnodes > loadmodel->numclipnodes ?
+        loadmodel->numnodes : loadmodel->numclipnodes;
+    stack = Hunk_AllocName((2 * size + MAX_MAP_HULLS) * sizeof(int),
+                           "hullpack");
+    mod_renumber[0] = Hunk_AllocName(loadmodel->numnodes * sizeof(int),
+                                     "hullpack");
+    mod_renumber[1] = Hunk_AllocName(loadmodel->numclipnodes * sizeof(int),
+                                     "hullpack");
+
+    if (Mod_PackHull(nodes[0], loadmodel->hulls[0].clipnodes,
+                     loadmodel->numnodes, 0, 0, mod_renumber[0], stack))
+        loadmodel->hulls[0].nodes = nodes[0];
+
+    if (Mod_PackHull(nodes[1], loadmodel->clipnodes,
+                     loadmodel->numclipnodes, 1, 2, mod_renumber[1],
+                     stack)) {
+        loadmodel->hulls[1].nodes = nodes[1];
+        loadmodel->hulls[2].nodes = nodes[1];
+    }
+
+    return mark;
+}
+
+/*
+==================
+Mod_HullNodeContents
+
+Mod_PointContents on the packed nodes, num is a packed node number
+==================
+*/
+int Mod_HullNodeContents(hull_t * hull, int num, vec3_t p)
+{
+    hullnode_t *node;
+    float d;
+
+    while (num >= 0) {
+        node = hull->nodes + num;
+        if (node->type < 3)
+            d = p[node->type] - node->dist;
+        else
+            d = DotProduct(node->normal, p) - node->dist;
+        num = node->children[d < 0];
+    }
+
+    return num;
+}
+
+typedef struct {
+    int num;                    // the node that split the segment
+    int side;                   // the side p1 is on
+    float frac;
+    float p1f, p2f, midf;
+    vec3_t p1, p2, mid;
+} hullsplit_t;
+
+/*
+==================
+Mod_TraceHull
+
+SV_RecursiveHullCheck from the head node on the packed nodes, with the
+same results.  A split that crosses a plane is pushed while the near
+side is walked, then popped to go past the node or to stop at it.  The
+caller fills trace in the same way as for the recursive check.  Returns
+false if the tree was too deep to finish, trace is garbage then.
+==================
+*/
+qboolean Mod_TraceHull(hull_t * hull, vec3_t start, vec3_t end,
+                       hulltrace_t * trace)
+{
+    hullsplit_t splits[MAX_HULLSPLITS], *s;
+    hullnode_t *node;
+    vec3_t p1, p2;
+    float p1f, p2f, t1, t2, frac;
+    int i, num, depth;
+
+    num = hull->firstnode;
+    p1f = 0;
+    p2f = 1;
+    VectorCopy(start, p1);
+    VectorCopy(end, p2);
+    depth = 0;
+
+    while (1) {
+        while (num >= 0) {
+            node = hull->nodes + num;
+            if (node->type < 3) {
+                t1 = p1[node->type] - node->dist;
+                t2 = p2[node->type] - node->dist;
+            } else {
+                t1 = DotProduct(node->normal, p1) - node->dist;
+                t2 = DotProduct(node->normal, p2) - node->dist;
+            }
+
+            if (t1 >= 0 && t2 >= 0) {
+                num = node->children[0];
+                continue;
+            }
+            if (t1 < 0 && t2 < 0) {
+                num = node->children[1];
+                continue;
+            }
+
+            if (depth == MAX_HULLSPLITS)
+                return false;
+            s = &splits[depth++];
+
+            // put the crosspoint DIST_EPSILON pixels on the near side
+            if (t1 < 0)
+                frac = (t1 + DIST_EPSILON) / (t1 - t2);
+            else
+                frac = (t1 - DIST_EPSILON) / (t1 - t2);
+            if (frac < 0)
+                frac = 0;
+            if (frac > 1)
+                frac = 1;
+
+            s->num = num;
+            s->side = (t1 < 0);
+            s->frac = frac;
+            s->p1f = p1f;
+            s->p2f = p2f;
+            s->midf = p1f + (p2f - p1f) * frac;
+            for (i = 0; i < 3; i++)
+                s->mid[i] = p1[i] + frac * (p2[i] - p1[i]);
+            VectorCopy(p1, s->p1);
+            VectorCopy(p2, s->p2);
+
+            // move up to the node
+            num = node->children[s->side];
+            p2f = s->midf;
+            VectorCopy(s->mid, p2);
+        }
+
+        // check for empty
+        if (num != CONTENTS_SOLID) {
+            trace->allsolid = false;
+            if (num == CONTENTS_EMPTY)
+                trace->inopen = true;
+            else
+                trace->inwater = true;
+        } else
+            trace->startsolid = true;
+
+        if (!depth)
+            return true;
+        s = &splits[--depth];
+        node = hull->nodes + s->num;
+
+        // go past the node
+        num = node->children[s->side ^ 1];
+        if (Mod_HullNodeContents(hull, num, s->mid) == CONTENTS_SOLID)
+            break;
+
+        p1f = s->midf;
+        p2f = s->p2f;
+        VectorCopy(s->mid, p1);
+        VectorCopy(s->p2, p2);
+    }
+
+    if (trace->allsolid)
+        return true;            // never got out of the solid area
+
+    // the other side of the node is solid, this is the impact point
+    if (!s->side) {
+        VectorCopy(node->normal, trace->normal);
+        trace->dist = node->dist;
+    } else {
+        VectorSubtract(vec3_origin, node->normal, trace->normal);
+        trace->dist = -node->dist;
+    }
+
+    while (Mod_HullNodeContents(hull, hull->firstnode, s->mid)
+           == CONTENTS_SOLID) { // shouldn't really happen, but does occasionally
+        s->frac -= 0.1;
+        if (s->frac < 0)
+            break;
+        s->midf = s->p1f + (s->p2f - s->p1f) * s->frac;
+        for (i = 0; i < 3; i++)
+            s->mid[i] = s->p1[i] + s->frac * (s->p2[i] - s->p1[i]);
+    }
+
+    trace->fraction = s->midf;
+    VectorCopy(s->mid, trace->endpos);
+
+    return true;
+}
+
 /*
 =================
 Mod_LoadMarksurfaces
@@ -994,7 +1300,7 @@ Mod_LoadBrushModel
 */
 void Mod_LoadBrushModel(model_t * mod, void *buffer)
 {
-    int i, j;
+    int i, j, mark;
     dheader_t *header;
     dmodel_t *bm;
 
@@ -1054,6 +1360,8 @@ void Mod_LoadBrushModel(model_t * mod, void *buffer)
 
     Mod_MakeHull0();
 
+    mark = Mod_PackHulls();
+
     mod->numframes = 2;         // regular and alternate animation
 
 //
@@ -1067,6 +1375,10 @@ void Mod_LoadBrushModel(model_t * mod, void *buffer)
             mod->hulls[j].firstclipnode = bm->headnode[j];
             mod->hulls[j].lastclipnode = mod->numclipnodes - 1;
         }
+        for (j = 0; j < MAX_MAP_HULLS; j++)
+            if (mod->hulls[j].nodes)
+                mod->hulls[j].firstnode =
+                    mod_renumber[j > 0][bm->headnode[j]];
 
         mod->firstmodelsurface = bm->firstface;
         mod->nummodelsurfaces = bm->numfaces;
@@ -1086,4 +1398,6 @@ void Mod_LoadBrushModel(model_t * mod, void *buffer)
             mod = loadmodel;
         }
     }
+
+    Hunk_FreeToLowMark(mark);
 }
@@ -168,6 +168,14 @@ typedef struct mleaf_s {
     byte ambient_sound_level[NUM_AMBIENTS];
 } mleaf_t;
 
+// a clipnode with its plane inlined, see Mod_PackHulls
+typedef struct {
+    vec3_t normal;
+    float dist;
+    int type;
+    short children[2];          // negative numbers are contents
+} hullnode_t;
+
 // !!! if this is changed, it must be changed in asm_i386.h too !!!
 typedef struct {
     dclipnode_t *clipnodes;
@@ -176,8 +184,21 @@ typedef struct {
     int lastclipnode;
     vec3_t clip_mins;
     vec3_t clip_maxs;
+    hullnode_t *nodes;          // clipnodes in depth first order, or NULL
+    int firstnode;              // firstclipnode in nodes
 } hull_t;
 
+// what Mod_TraceHull fills in, the callers copy it to their own traces
+typedef struct {
+    qboolean allsolid;
+    qboolean startsolid;
+    qboolean inopen, inwater;
+    float fraction;
+    vec3_t endpos;
+    vec3_t normal;
+    float dist;
+} hulltrace_t;
+
 /*
 ==============================================================================
 
@@ -380,4 +401,10 @@ void Mod_TouchModel(char *name);
 mleaf_t *Mod_PointInLeaf(float *p, model_t * model);
 byte *Mod_LeafPVS(mleaf_t * leaf, model_t * model);
 
+extern cvar_t sv_hullnodes;
+
+int Mod_HullNodeContents(hull_t * hull, int num, vec3_t p);
+qboolean Mod_TraceHull(hull_t * hull, vec3_t p1, vec3_t p2,
+                       hulltrace_t * trace);
+
 #endif                          // __MODEL__
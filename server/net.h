@@ -39,6 +39,13 @@ void NET_Init(int port);
 void NET_Shutdown(void);
 qboolean NET_GetPacket(void);
 void NET_SendPacket(int length, void *data, netadr_t to);
+void NET_BeginSend(void);
+void NET_FlushSend(void);
+int NET_WaitFd(void);
+qboolean NET_StatusWanted(void);
+void NET_SetStatus(int length, void *data);
+
+extern cvar_t net_batch;
 
 qboolean NET_CompareAdr(netadr_t a, netadr_t b);
 qboolean NET_CompareBaseAdr(netadr_t a, netadr_t b);
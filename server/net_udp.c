@@ -19,6 +19,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 // net_main.c
 
+#define _GNU_SOURCE             // recvmmsg/sendmmsg
+
 #include "qwsvdef.h"
 
 #include <sys/types.h>
@@ -30,6 +32,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <sys/uio.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
 
 #if defined(sun)
 #include <unistd.h>
@@ -53,8 +58,87 @@ int net_send_socket;            // blocking, for sends
 #define	MAX_UDP_PACKET	8192
 byte net_message_buffer[MAX_UDP_PACKET];
 
-int gethostname(char *, int);
-int close(int);
+cvar_t net_batch = { "net_batch", "1" };        // use recvmmsg/sendmmsg
+
+#ifdef MSG_WAITFORONE
+#define	NET_MMSG
+#endif
+
+#ifdef NET_MMSG
+
+#define	NET_BATCH	32
+
+// packets drained by recvmmsg, handed out one by one by NET_GetPacket
+static struct mmsghdr net_recvmsgs[NET_BATCH];
+static struct iovec net_recviov[NET_BATCH];
+static struct sockaddr_in net_recvaddrs[NET_BATCH];
+static byte net_recvbufs[NET_BATCH][MAX_UDP_PACKET];
+static int net_recvnext, net_recvcount;
+
+// packets held between NET_BeginSend and NET_FlushSend
+static struct mmsghdr net_sendmsgs[NET_BATCH];
+static struct iovec net_sendiov[NET_BATCH];
+static struct sockaddr_in net_sendaddrs[NET_BATCH];
+static byte net_sendbufs[NET_BATCH][MAX_UDP_PACKET];
+static int net_sendcount;
+static qboolean net_queuesends;
+
+static qboolean net_nommsg;     // the kernel doesn't have them
+
+#endif
+
+/*
+==============================================================================
+
+NETWORK THREAD
+
+With -netthread a thread of its own owns the socket.  It pushes the
+packets it reads into net_inring for NET_GetPacket and sends whatever
+NET_SendPacket leaves in net_outring, so the frame never waits on a socket
+call.  Each ring has one producer and one consumer and takes no lock: only
+the producer moves head and only the consumer moves tail.
+
+The main loop waits on NET_WaitFd, which is a pipe the thread writes to
+when it has pushed packets instead of the socket itself.
+
+Server browsers get their ping and status replies from the thread itself,
+out of a copy of the status that the server refreshes when asked to.  The
+server hands over an empty copy while an ip filter could turn a query
+away, and then every query goes through SV_ReadPackets as before.
+
+==============================================================================
+*/
+
+#define	NET_RINGSIZE	256     // power of two
+
+typedef struct {
+    netadr_t adr;
+    int length;
+    byte data[MAX_UDP_PACKET];
+} netpacket_t;
+
+typedef struct {
+    netpacket_t packets[NET_RINGSIZE];
+    unsigned head;              // next slot to fill, moved by the producer
+    unsigned tail;              // next slot to empty, moved by the consumer
+} netring_t;
+
+static netring_t net_inring, net_outring;
+
+static qboolean net_threaded;
+static qboolean net_holding;    // net_message points into net_inring
+static qboolean net_holdwake;   // between NET_BeginSend and NET_FlushSend
+static pthread_t net_thread;
+static int net_wakepipe[2];     // server to thread: net_outring has packets
+static int net_readypipe[2];    // thread to server: net_inring has packets
+static int net_threadquit;
+
+static pthread_mutex_t net_statuslock = PTHREAD_MUTEX_INITIALIZER;
+static byte net_status[MAX_UDP_PACKET];
+static int net_statuslength;
+static double net_statustime;
+static qboolean net_statuswanted;
+
 
 //=============================================================================
 
@@ -186,13 +270,431 @@ qboolean NET_IsClientLegal(netadr_t * adr)
 
 //=============================================================================
 
+// producer: the slot to fill next, NULL if the ring is full
+static netpacket_t *NET_RingSlot(netring_t * r)
+{
+    if (r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) ==
+        NET_RINGSIZE)
+        return NULL;
+    return &r->packets[r->head & (NET_RINGSIZE - 1)];
+}
+
+static void NET_RingPush(netring_t * r)
+{
+    __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+// consumer: the number of packets waiting, NET_RingPacket(r, 0) first
+static int NET_RingCount(netring_t * r)
+{
+    return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - r->tail;
+}
+
+static netpacket_t *NET_RingPacket(netring_t * r, int i)
+{
+    return &r->packets[(r->tail + i) & (NET_RINGSIZE - 1)];
+}
+
+static void NET_RingRelease(netring_t * r, int count)
+{
+    __atomic_store_n(&r->tail, r->tail + count, __ATOMIC_RELEASE);
+}
+
+static void NET_WakeThread(void)
+{
+    svs.stats.syscalls++;
+    write(net_wakepipe[1], "", 1);
+}
+
+/*
+=============
+NET_ThreadAnswer
+
+Replies to a ping or status query from the status copy if it is recent,
+true if the packet needs nothing more
+=============
+*/
+static qboolean NET_ThreadAnswer(netpacket_t * p)
+{
+    struct sockaddr_in addr;
+    char *s, *end;
+    byte ack;
+    qboolean ping, status, answered;
+    int len;
+
+    if (p->length < 5 || *(int *) p->data != -1)
+        return false;
+
+    // the first word of the line, as Cmd_TokenizeString finds it
+    end = (char *) p->data + p->length;
+    for (s = (char *) p->data + 4; s < end && *s && *s <= ' ' && *s != '\n';
+         s++);
+    for (len = 0; s + len < end && (byte) s[len] > ' '; len++);
+
+    ping = (len == 4 && !strncmp(s, "ping", 4))
+        || (len == 1 && s[0] == A2A_PING);
+    status = len == 6 && !strncmp(s, "status", 6);
+    if (!ping && !status)
+        return false;
+
+    pthread_mutex_lock(&net_statuslock);
+    net_statuswanted = true;
+    answered = net_statuslength && Sys_DoubleTime() - net_statustime < 1;
+    if (answered) {
+        NetadrToSockadr(&p->adr, &addr);
+        ack = A2A_ACK;
+        if (ping)
+            sendto(net_socket, &ack, 1, 0, (struct sockaddr *) &addr,
+                   sizeof(addr));
+        else
+            sendto(net_socket, net_status, net_statuslength, 0,
+                   (struct sockaddr *) &addr, sizeof(addr));
+    }
+    pthread_mutex_unlock(&net_statuslock);
+
+    return answered;
+}
+
+// reads everything the socket has, or until the server falls behind and
+// the rest has to wait in the socket buffer
+static void NET_ThreadRecv(void)
+{
+    struct sockaddr_in from;
+    socklen_t fromlen;
+    netpacket_t *p;
+    int ret, pushed;
+
+    pushed = 0;
+    while ((p = NET_RingSlot(&net_inring))) {
+        fromlen = sizeof(from);
+        ret = recvfrom(net_socket, p->data, MAX_UDP_PACKET, 0,
+                       (struct sockaddr *) &from, &fromlen);
+        if (ret == -1)
+            break;              // EWOULDBLOCK, or nothing worth a print here
+        if (!ret)
+            continue;           // empty, NET_GetPacket never returned those
+
+        p->length = ret;
+        SockadrToNetadr(&from, &p->adr);
+        if (!NET_ThreadAnswer(p)) {
+            NET_RingPush(&net_inring);
+            pushed++;
+        }
+    }
+
+    if (pushed)
+        write(net_readypipe[1], "", 1);
+}
+
+static void NET_ThreadSend(void)
+{
+    struct sockaddr_in addr;
+    netpacket_t *p;
+    int i, count;
+#ifdef NET_MMSG
+    struct mmsghdr msgs[NET_BATCH];
+    struct iovec iov[NET_BATCH];
+    struct sockaddr_in addrs[NET_BATCH];
+    int ret, sent;
+#endif
+
+    while ((count = NET_RingCount(&net_outring))) {
+        if (count > NET_BATCH)
+            count = NET_BATCH;
+
+#ifdef NET_MMSG
+        if (!net_nommsg) {
+            memset(msgs, 0, count * sizeof(msgs[0]));
+            for (i = 0; i < count; i++) {
+                p = NET_RingPacket(&net_outring, i);
+                NetadrToSockadr(&p->adr, &addrs[i]);
+                iov[i].iov_base = p->data;
+                iov[i].iov_len = p->length;
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                msgs[i].msg_hdr.msg_name = &addrs[i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+            }
+
+            for (sent = 0; sent < count; sent++) {
+                ret = sendmmsg(net_socket, msgs + sent, count - sent, 0);
+                if (ret > 0)
+                    sent += ret - 1;
+                else if (ret == -1 && errno == ENOSYS) {
+                    net_nommsg = true;
+                    break;
+                }
+                // a full socket drops the packet, as sendto did
+            }
+
+            NET_RingRelease(&net_outring, sent);
+            continue;
+        }
+#endif
+
+        for (i = 0; i < count; i++) {
+            p = NET_RingPacket(&net_outring, i);
+            NetadrToSockadr(&p->adr, &addr);
+            sendto(net_socket, p->data, p->length, 0,
+                   (struct sockaddr *) &addr, sizeof(addr));
+        }
+        NET_RingRelease(&net_outring, count);
+    }
+}
+
+static void *NET_Thread(void *arg)
+{
+    struct pollfd fds[2];
+    char buf[64];
+    qboolean full;
+
+    fds[0].fd = net_wakepipe[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = net_socket;
+    fds[1].events = POLLIN;
+
+    while (!__atomic_load_n(&net_threadquit, __ATOMIC_ACQUIRE)) {
+        // nothing wakes us when the server makes room in a full ring
+        full = !NET_RingSlot(&net_inring);
+        fds[0].revents = 0;
+        poll(fds, full ? 1 : 2, full ? 1 : 100);
+
+        if (fds[0].revents)
+            while (read(net_wakepipe[0], buf, sizeof(buf)) > 0);
+
+        NET_ThreadSend();
+        NET_ThreadRecv();
+    }
+
+    // whatever the server said last
+    NET_ThreadSend();
+
+    return NULL;
+}
+
+static void NET_StartThread(void)
+{
+    qboolean _true = true;
+
+    int i;
+
+    if (pipe(net_wakepipe) == -1 || pipe(net_readypipe) == -1)
+        Sys_Error("NET_StartThread: pipe: %s", strerror(errno));
+    for (i = 0; i < 2; i++) {
+        ioctl(net_wakepipe[i], FIONBIO, (char *) &_true);
+        ioctl(net_readypipe[i], FIONBIO, (char *) &_true);
+    }
+
+    if (pthread_create(&net_thread, NULL, NET_Thread, NULL)) {
+        Con_Printf("NET_StartThread: no thread, using the socket directly\n");
+        for (i = 0; i < 2; i++) {
+            close(net_wakepipe[i]);
+            close(net_readypipe[i]);
+        }
+        return;
+    }
+
+    net_threaded = true;
+    Con_Printf("Network thread started\n");
+}
+
+static void NET_StopThread(void)
+{
+    int i;
+
+    if (!net_threaded)
+        return;
+
+    __atomic_store_n(&net_threadquit, 1, __ATOMIC_RELEASE);
+    NET_WakeThread();
+    pthread_join(net_thread, NULL);
+
+    for (i = 0; i < 2; i++) {
+        close(net_wakepipe[i]);
+        close(net_readypipe[i]);
+    }
+    net_threaded = false;
+}
+
+/*
+=============
+NET_WaitFd
+
+The descriptor that becomes readable when NET_GetPacket has packets
+=============
+*/
+int NET_WaitFd(void)
+{
+    return net_threaded ? net_readypipe[0] : net_socket;
+}
+
+/*
+=============
+NET_StatusWanted
+
+True when the network thread has had queries since its status copy was
+last refreshed, and the copy is getting old
+=============
+*/
+qboolean NET_StatusWanted(void)
+{
+    qboolean wanted;
+
+    if (!net_threaded)
+        return false;
+
+    pthread_mutex_lock(&net_statuslock);
+    wanted = net_statuswanted && Sys_DoubleTime() - net_statustime > 0.5;
+    pthread_mutex_unlock(&net_statuslock);
+
+    return wanted;
+}
+
+/*
+=============
+NET_SetStatus
+
+Hands the network thread the reply to a status query, a length of 0
+makes it pass every query on to the server
+=============
+*/
+void NET_SetStatus(int length, void *data)
+{
+    if (length > MAX_UDP_PACKET)
+        length = 0;
+
+    pthread_mutex_lock(&net_statuslock);
+    memcpy(net_status, data, length);
+    net_statuslength = length;
+    net_statustime = Sys_DoubleTime();
+    net_statuswanted = false;
+    pthread_mutex_unlock(&net_statuslock);
+}
+
+// hands out the packets the network thread has read
+static qboolean NET_GetThreadPacket(void)
+{
+    netpacket_t *p;
+    char buf[64];
+
+    if (net_holding) {
+        NET_RingRelease(&net_inring, 1);
+        net_holding = false;
+    }
+
+    if (!NET_RingCount(&net_inring)) {
+        // a packet pushed after this read writes to the pipe again
+        svs.stats.syscalls++;
+        while (read(net_readypipe[0], buf, sizeof(buf)) > 0);
+        if (!NET_RingCount(&net_inring))
+            return false;
+    }
+
+    p = NET_RingPacket(&net_inring, 0);
+    net_message.data = p->data;
+    net_message.cursize = p->length;
+    net_from = p->adr;
+    net_holding = true;
+
+    return true;
+}
+
+static void NET_QueueThreadPacket(int length, void *data, netadr_t to)
+{
+    netpacket_t *p;
+
+    // a full ring drops the packet, as a full socket would
+    if (length > MAX_UDP_PACKET || !(p = NET_RingSlot(&net_outring)))
+        return;
+
+    p->adr = to;
+    p->length = length;
+    memcpy(p->data, data, length);
+    NET_RingPush(&net_outring);
+
+    if (!net_holdwake)
+        NET_WakeThread();
+}
+
+//=============================================================================
+
+#ifdef NET_MMSG
+
+/*
+=============
+NET_RecvBatch
+
+Drains up to NET_BATCH packets with one recvmmsg, false if there were none
+=============
+*/
+static qboolean NET_RecvBatch(void)
+{
+    int i, ret;
+
+    for (i = 0; i < NET_BATCH; i++) {
+        net_recviov[i].iov_base = net_recvbufs[i];
+        net_recviov[i].iov_len = MAX_UDP_PACKET;
+        net_recvmsgs[i].msg_hdr.msg_iov = &net_recviov[i];
+        net_recvmsgs[i].msg_hdr.msg_iovlen = 1;
+        net_recvmsgs[i].msg_hdr.msg_name = &net_recvaddrs[i];
+        net_recvmsgs[i].msg_hdr.msg_namelen = sizeof(net_recvaddrs[i]);
+        net_recvmsgs[i].msg_hdr.msg_control = NULL;
+        net_recvmsgs[i].msg_hdr.msg_controllen = 0;
+        net_recvmsgs[i].msg_hdr.msg_flags = 0;
+    }
+
+    svs.stats.syscalls++;
+    ret = recvmmsg(net_socket, net_recvmsgs, NET_BATCH, MSG_DONTWAIT, NULL);
+    if (ret == -1) {
+        if (errno == ENOSYS) {
+            Sys_Printf("NET_RecvBatch: no recvmmsg, using recvfrom\n");
+            net_nommsg = true;
+        } else if (errno != EWOULDBLOCK && errno != ECONNREFUSED)
+            Sys_Printf("NET_RecvBatch: %s\n", strerror(errno));
+        return false;
+    }
+
+    net_recvnext = 0;
+    net_recvcount = ret;
+
+    return ret > 0;
+}
+
+#endif
+
 qboolean NET_GetPacket(void)
 {
     int ret;
+#ifdef NET_MMSG
+    int i;
+#endif
     struct sockaddr_in from;
     socklen_t fromlen;
 
+    if (net_threaded)
+        return NET_GetThreadPacket();
+
+#ifdef NET_MMSG
+    while (net_recvnext < net_recvcount
+           || (net_batch.value && !net_nommsg && NET_RecvBatch())) {
+        i = net_recvnext++;
+
+        // anyone can send an empty datagram, it mustn't end the read
+        // while the rest of the batch waits
+        if (!net_recvmsgs[i].msg_len)
+            continue;
+
+        net_message.data = net_recvbufs[i];
+        net_message.cursize = net_recvmsgs[i].msg_len;
+        SockadrToNetadr(&net_recvaddrs[i], &net_from);
+        return true;
+    }
+#endif
+
+    net_message.data = net_message_buffer;
+
     fromlen = sizeof(from);
+    svs.stats.syscalls++;
     ret =
         recvfrom(net_socket, net_message_buffer,
                  sizeof(net_message_buffer), 0, (struct sockaddr *) &from,
@@ -214,13 +716,136 @@ qboolean NET_GetPacket(void)
 
 //=============================================================================
 
+#ifdef NET_MMSG
+
+/*
+=============
+NET_BeginSend
+
+Packets sent until NET_FlushSend are queued and go out in one sendmmsg
+=============
+*/
+void NET_BeginSend(void)
+{
+    if (net_threaded) {
+        net_holdwake = true;
+        return;
+    }
+
+    net_queuesends = net_batch.value && !net_nommsg;
+}
+
+static void NET_SendEach(int first)
+{
+    int i;
+
+    for (i = first; i < net_sendcount; i++) {
+        svs.stats.syscalls++;
+        if (sendto(net_socket, net_sendbufs[i], net_sendiov[i].iov_len, 0,
+                   (struct sockaddr *) &net_sendaddrs[i],
+                   sizeof(net_sendaddrs[i])) == -1
+            && errno != EWOULDBLOCK && errno != ECONNREFUSED)
+            Sys_Printf("NET_SendPacket: %s\n", strerror(errno));
+    }
+}
+
+void NET_FlushSend(void)
+{
+    int sent, ret;
+
+    if (net_threaded) {
+        net_holdwake = false;
+        if (NET_RingCount(&net_outring))
+            NET_WakeThread();
+        return;
+    }
+
+    sent = 0;
+    while (sent < net_sendcount) {
+        svs.stats.syscalls++;
+        ret = sendmmsg(net_socket, net_sendmsgs + sent,
+                       net_sendcount - sent, 0);
+        if (ret > 0) {
+            sent += ret;
+            continue;
+        }
+
+        if (ret == -1 && errno == ENOSYS) {
+            Sys_Printf("NET_FlushSend: no sendmmsg, using sendto\n");
+            net_nommsg = true;
+            NET_SendEach(sent);
+            break;
+        }
+        // a full socket drops the packet, as sendto did
+        if (ret == -1 && errno != EWOULDBLOCK && errno != ECONNREFUSED)
+            Sys_Printf("NET_FlushSend: %s\n", strerror(errno));
+        sent++;
+    }
+
+    net_sendcount = 0;
+    net_queuesends = false;
+}
+
+static void NET_QueuePacket(int length, void *data, netadr_t to)
+{
+    struct mmsghdr *m;
+    int i;
+
+    if (net_sendcount == NET_BATCH) {
+        NET_FlushSend();
+        net_queuesends = true;
+    }
+
+    i = net_sendcount++;
+    memcpy(net_sendbufs[i], data, length);
+    NetadrToSockadr(&to, &net_sendaddrs[i]);
+
+    net_sendiov[i].iov_base = net_sendbufs[i];
+    net_sendiov[i].iov_len = length;
+
+    m = &net_sendmsgs[i];
+    memset(m, 0, sizeof(*m));
+    m->msg_hdr.msg_iov = &net_sendiov[i];
+    m->msg_hdr.msg_iovlen = 1;
+    m->msg_hdr.msg_name = &net_sendaddrs[i];
+    m->msg_hdr.msg_namelen = sizeof(net_sendaddrs[i]);
+}
+
+#else
+
+void NET_BeginSend(void)
+{
+    net_holdwake = net_threaded;
+}
+
+void NET_FlushSend(void)
+{
+    if (net_holdwake && NET_RingCount(&net_outring))
+        NET_WakeThread();
+    net_holdwake = false;
+}
+
+#endif
+
 void NET_SendPacket(int length, void *data, netadr_t to)
 {
     int ret;
     struct sockaddr_in addr;
 
+    if (net_threaded) {
+        NET_QueueThreadPacket(length, data, to);
+        return;
+    }
+#ifdef NET_MMSG
+    if (net_queuesends && length <= MAX_UDP_PACKET) {
+        NET_QueuePacket(length, data, to);
+        return;
+    }
+#endif
+
     NetadrToSockadr(&to, &addr);
 
+    svs.stats.syscalls++;
     ret =
         sendto(net_socket, data, length, 0, (struct sockaddr *) &addr,
                sizeof(addr));
@@ -308,6 +933,9 @@ void NET_Init(int port)
     NET_GetLocalAddress();
 
     Con_Printf("UDP Initialized\n");
+
+    if (COM_CheckParm("-netthread"))
+        NET_StartThread();
 }
 
 /*
@@ -317,5 +945,6 @@ NET_Shutdown
 */
 void NET_Shutdown(void)
 {
+    NET_StopThread();
     close(net_socket);
 }
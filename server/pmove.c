@@ -25,16 +25,6 @@ movevars_t movevars;
 
 playermove_t pmove;
 
-static pmplane_t groundplane;
-
-int onground;
-int waterlevel;
-int watertype;
-
-float frametime;
-
-vec3_t forward, right, up;
-
 vec3_t player_mins = { -16, -16, -24 };
 vec3_t player_maxs = { 16, 16, 32 };
 
@@ -48,11 +38,11 @@ vec3_t player_maxs = { 16, 16, 32 };
 // #define      PM_FRICTION                     6
 // #define      PM_WATERFRICTION        1
 
-void PM_InitBoxHull(void);
+void PM_InitBoxClipnodes(void);
 
 void Pmove_Init(void)
 {
-    PM_InitBoxHull();
+    PM_InitBoxClipnodes();
 }
 
 #define	STEPSIZE	18
@@ -105,7 +95,7 @@ The basic solid body movement clip that slides along multiple planes
 */
 #define	MAX_CLIP_PLANES	5
 
-int PM_FlyMove(void)
+int PM_FlyMove(playermove_t * pm)
 {
     int bumpcount, numbumps;
     vec3_t dir;
@@ -122,25 +112,25 @@ int PM_FlyMove(void)
     numbumps = 4;
 
     blocked = 0;
-    VectorCopy(pmove.velocity, original_velocity);
-    VectorCopy(pmove.velocity, primal_velocity);
+    VectorCopy(pm->velocity, original_velocity);
+    VectorCopy(pm->velocity, primal_velocity);
     numplanes = 0;
 
-    time_left = frametime;
+    time_left = pm->frametime;
 
     for (bumpcount = 0; bumpcount < numbumps; bumpcount++) {
         for (i = 0; i < 3; i++)
-            end[i] = pmove.origin[i] + time_left * pmove.velocity[i];
+            end[i] = pm->origin[i] + time_left * pm->velocity[i];
 
-        trace = PM_PlayerMove(pmove.origin, end);
+        trace = PM_PlayerMove(pm, pm->origin, end);
 
         if (trace.startsolid || trace.allsolid) {       // entity is trapped in another solid
-            VectorCopy(vec3_origin, pmove.velocity);
+            VectorCopy(vec3_origin, pm->velocity);
             return 3;
         }
 
         if (trace.fraction > 0) {       // actually covered some distance
-            VectorCopy(trace.endpos, pmove.origin);
+            VectorCopy(trace.endpos, pm->origin);
             numplanes = 0;
         }
 
@@ -148,8 +138,8 @@ int PM_FlyMove(void)
             break;              // moved the entire distance
 
         // save entity for contact
-        pmove.touchindex[pmove.numtouch] = trace.ent;
-        pmove.numtouch++;
+        pm->touchindex[pm->numtouch] = trace.ent;
+        pm->numtouch++;
 
         if (trace.plane.normal[2] > 0.7) {
             blocked |= 1;       // floor
@@ -162,7 +152,7 @@ int PM_FlyMove(void)
 
         // cliped to another plane
         if (numplanes >= MAX_CLIP_PLANES) {     // this shouldn't really happen
-            VectorCopy(vec3_origin, pmove.velocity);
+            VectorCopy(vec3_origin, pm->velocity);
             break;
         }
 
@@ -173,11 +163,11 @@ int PM_FlyMove(void)
 // modify original_velocity so it parallels all of the clip planes
 //
         for (i = 0; i < numplanes; i++) {
-            PM_ClipVelocity(original_velocity, planes[i], pmove.velocity,
+            PM_ClipVelocity(original_velocity, planes[i], pm->velocity,
                             1);
             for (j = 0; j < numplanes; j++)
                 if (j != i) {
-                    if (DotProduct(pmove.velocity, planes[j]) < 0)
+                    if (DotProduct(pm->velocity, planes[j]) < 0)
                         break;  // not ok
                 }
             if (j == numplanes)
@@ -188,26 +178,26 @@ int PM_FlyMove(void)
         } else {                // go along the crease
             if (numplanes != 2) {
 //                              Con_Printf ("clip velocity, numplanes == %i\n",numplanes);
-                VectorCopy(vec3_origin, pmove.velocity);
+                VectorCopy(vec3_origin, pm->velocity);
                 break;
             }
             CrossProduct(planes[0], planes[1], dir);
-            d = DotProduct(dir, pmove.velocity);
-            VectorScale(dir, d, pmove.velocity);
+            d = DotProduct(dir, pm->velocity);
+            VectorScale(dir, d, pm->velocity);
         }
 
 //
 // if original velocity is against the original velocity, stop dead
 // to avoid tiny occilations in sloping corners
 //
-        if (DotProduct(pmove.velocity, primal_velocity) <= 0) {
-            VectorCopy(vec3_origin, pmove.velocity);
+        if (DotProduct(pm->velocity, primal_velocity) <= 0) {
+            VectorCopy(vec3_origin, pm->velocity);
             break;
         }
     }
 
-    if (pmove.waterjumptime) {
-        VectorCopy(primal_velocity, pmove.velocity);
+    if (pm->waterjumptime) {
+        VectorCopy(primal_velocity, pm->velocity);
     }
     return blocked;
 }
@@ -219,62 +209,62 @@ PM_GroundMove
 Player is on ground, with no upwards velocity
 =============
 */
-void PM_GroundMove(void)
+void PM_GroundMove(playermove_t * pm)
 {
     vec3_t dest;
     pmtrace_t trace;
     vec3_t original, originalvel, down, up, downvel;
     float downdist, updist;
 
-    pmove.velocity[2] = 0;
-    if (!pmove.velocity[0] && !pmove.velocity[1] && !pmove.velocity[2])
+    pm->velocity[2] = 0;
+    if (!pm->velocity[0] && !pm->velocity[1] && !pm->velocity[2])
         return;
 
     // first try just moving to the destination     
-    dest[0] = pmove.origin[0] + pmove.velocity[0] * frametime;
-    dest[1] = pmove.origin[1] + pmove.velocity[1] * frametime;
-    dest[2] = pmove.origin[2];
+    dest[0] = pm->origin[0] + pm->velocity[0] * pm->frametime;
+    dest[1] = pm->origin[1] + pm->velocity[1] * pm->frametime;
+    dest[2] = pm->origin[2];
 
     // first try moving directly to the next spot
-    trace = PM_PlayerMove(pmove.origin, dest);
+    trace = PM_PlayerMove(pm, pm->origin, dest);
     if (trace.fraction == 1) {
-        VectorCopy(trace.endpos, pmove.origin);
+        VectorCopy(trace.endpos, pm->origin);
         return;
     }
     // try sliding forward both on ground and up 16 pixels
     // take the move that goes farthest
-    VectorCopy(pmove.origin, original);
-    VectorCopy(pmove.velocity, originalvel);
+    VectorCopy(pm->origin, original);
+    VectorCopy(pm->velocity, originalvel);
 
     // slide move
-    PM_FlyMove();
+    PM_FlyMove(pm);
 
-    VectorCopy(pmove.origin, down);
-    VectorCopy(pmove.velocity, downvel);
+    VectorCopy(pm->origin, down);
+    VectorCopy(pm->velocity, downvel);
 
-    VectorCopy(original, pmove.origin);
-    VectorCopy(originalvel, pmove.velocity);
+    VectorCopy(original, pm->origin);
+    VectorCopy(originalvel, pm->velocity);
 
 // move up a stair height
-    VectorCopy(pmove.origin, dest);
+    VectorCopy(pm->origin, dest);
     dest[2] += STEPSIZE;
-    trace = PM_PlayerMove(pmove.origin, dest);
+    trace = PM_PlayerMove(pm, pm->origin, dest);
     if (!trace.startsolid && !trace.allsolid) {
-        VectorCopy(trace.endpos, pmove.origin);
+        VectorCopy(trace.endpos, pm->origin);
     }
 // slide move
-    PM_FlyMove();
+    PM_FlyMove(pm);
 
 // press down the stepheight
-    VectorCopy(pmove.origin, dest);
+    VectorCopy(pm->origin, dest);
     dest[2] -= STEPSIZE;
-    trace = PM_PlayerMove(pmove.origin, dest);
+    trace = PM_PlayerMove(pm, pm->origin, dest);
     if (trace.plane.normal[2] < 0.7)
         goto usedown;
     if (!trace.startsolid && !trace.allsolid) {
-        VectorCopy(trace.endpos, pmove.origin);
+        VectorCopy(trace.endpos, pm->origin);
     }
-    VectorCopy(pmove.origin, up);
+    VectorCopy(pm->origin, up);
 
     // decide which one went farther
     downdist = (down[0] - original[0]) * (down[0] - original[0])
@@ -284,10 +274,10 @@ void PM_GroundMove(void)
 
     if (downdist > updist) {
       usedown:
-        VectorCopy(down, pmove.origin);
-        VectorCopy(downvel, pmove.velocity);
+        VectorCopy(down, pm->origin);
+        VectorCopy(downvel, pm->velocity);
     } else                      // copy z value from slide move
-        pmove.velocity[2] = downvel[2];
+        pm->velocity[2] = downvel[2];
 
 // if at a dead stop, retry the move with nudges to get around lips
 
@@ -302,7 +292,7 @@ PM_Friction
 Handles both ground friction and water friction
 ==================
 */
-void PM_Friction(void)
+void PM_Friction(playermove_t * pm)
 {
     float *vel;
     float speed, newspeed, control;
@@ -311,10 +301,10 @@ void PM_Friction(void)
     vec3_t start, stop;
     pmtrace_t trace;
 
-    if (pmove.waterjumptime)
+    if (pm->waterjumptime)
         return;
 
-    vel = pmove.velocity;
+    vel = pm->velocity;
 
     speed = sqrt(vel[0] * vel[0] + vel[1] * vel[1] + vel[2] * vel[2]);
     if (speed < 1) {
@@ -323,16 +313,16 @@ void PM_Friction(void)
         return;
     }
 
-    friction = movevars.friction;
+    friction = pm->movevars.friction;
 
 // if the leading edge is over a dropoff, increase friction
-    if (onground != -1) {
-        start[0] = stop[0] = pmove.origin[0] + vel[0] / speed * 16;
-        start[1] = stop[1] = pmove.origin[1] + vel[1] / speed * 16;
-        start[2] = pmove.origin[2] + player_mins[2];
+    if (pm->onground != -1) {
+        start[0] = stop[0] = pm->origin[0] + vel[0] / speed * 16;
+        start[1] = stop[1] = pm->origin[1] + vel[1] / speed * 16;
+        start[2] = pm->origin[2] + player_mins[2];
         stop[2] = start[2] - 34;
 
-        trace = PM_PlayerMove(start, stop);
+        trace = PM_PlayerMove(pm, start, stop);
 
         if (trace.fraction == 1) {
             friction *= 2;
@@ -341,12 +331,12 @@ void PM_Friction(void)
 
     drop = 0;
 
-    if (waterlevel >= 2)        // apply water friction
-        drop += speed * movevars.waterfriction * waterlevel * frametime;
-    else if (onground != -1)    // apply ground friction
+    if (pm->waterlevel >= 2)        // apply water friction
+        drop += speed * pm->movevars.waterfriction * pm->waterlevel * pm->frametime;
+    else if (pm->onground != -1)    // apply ground friction
     {
-        control = speed < movevars.stopspeed ? movevars.stopspeed : speed;
-        drop += control * friction * frametime;
+        control = speed < pm->movevars.stopspeed ? pm->movevars.stopspeed : speed;
+        drop += control * friction * pm->frametime;
     }
 
 // scale the velocity
@@ -366,50 +356,52 @@ void PM_Friction(void)
 PM_Accelerate
 ==============
 */
-void PM_Accelerate(vec3_t wishdir, float wishspeed, float accel)
+void PM_Accelerate(playermove_t * pm, vec3_t wishdir, float wishspeed,
+                   float accel)
 {
     int i;
     float addspeed, accelspeed, currentspeed;
 
-    if (pmove.dead)
+    if (pm->dead)
         return;
-    if (pmove.waterjumptime)
+    if (pm->waterjumptime)
         return;
 
-    currentspeed = DotProduct(pmove.velocity, wishdir);
+    currentspeed = DotProduct(pm->velocity, wishdir);
     addspeed = wishspeed - currentspeed;
     if (addspeed <= 0)
         return;
-    accelspeed = accel * frametime * wishspeed;
+    accelspeed = accel * pm->frametime * wishspeed;
     if (accelspeed > addspeed)
         accelspeed = addspeed;
 
     for (i = 0; i < 3; i++)
-        pmove.velocity[i] += accelspeed * wishdir[i];
+        pm->velocity[i] += accelspeed * wishdir[i];
 }
 
-void PM_AirAccelerate(vec3_t wishdir, float wishspeed, float accel)
+void PM_AirAccelerate(playermove_t * pm, vec3_t wishdir, float wishspeed,
+                      float accel)
 {
     int i;
     float addspeed, accelspeed, currentspeed, wishspd = wishspeed;
 
-    if (pmove.dead)
+    if (pm->dead)
         return;
-    if (pmove.waterjumptime)
+    if (pm->waterjumptime)
         return;
 
     if (wishspd > 30)
         wishspd = 30;
-    currentspeed = DotProduct(pmove.velocity, wishdir);
+    currentspeed = DotProduct(pm->velocity, wishdir);
     addspeed = wishspd - currentspeed;
     if (addspeed <= 0)
         return;
-    accelspeed = accel * wishspeed * frametime;
+    accelspeed = accel * wishspeed * pm->frametime;
     if (accelspeed > addspeed)
         accelspeed = addspeed;
 
     for (i = 0; i < 3; i++)
-        pmove.velocity[i] += accelspeed * wishdir[i];
+        pm->velocity[i] += accelspeed * wishdir[i];
 }
 
 
@@ -420,7 +412,7 @@ PM_WaterMove
 
 ===================
 */
-void PM_WaterMove(void)
+void PM_WaterMove(playermove_t * pm)
 {
     int i;
     vec3_t wishvel;
@@ -434,44 +426,44 @@ void PM_WaterMove(void)
 //
     for (i = 0; i < 3; i++)
         wishvel[i] =
-            forward[i] * pmove.cmd.forwardmove +
-            right[i] * pmove.cmd.sidemove;
+            pm->forward[i] * pm->cmd.forwardmove +
+            pm->right[i] * pm->cmd.sidemove;
 
-    if (!pmove.cmd.forwardmove && !pmove.cmd.sidemove && !pmove.cmd.upmove)
+    if (!pm->cmd.forwardmove && !pm->cmd.sidemove && !pm->cmd.upmove)
         wishvel[2] -= 60;       // drift towards bottom
     else
-        wishvel[2] += pmove.cmd.upmove;
+        wishvel[2] += pm->cmd.upmove;
 
     VectorCopy(wishvel, wishdir);
     wishspeed = VectorNormalize(wishdir);
 
-    if (wishspeed > movevars.maxspeed) {
-        VectorScale(wishvel, movevars.maxspeed / wishspeed, wishvel);
-        wishspeed = movevars.maxspeed;
+    if (wishspeed > pm->movevars.maxspeed) {
+        VectorScale(wishvel, pm->movevars.maxspeed / wishspeed, wishvel);
+        wishspeed = pm->movevars.maxspeed;
     }
     wishspeed *= 0.7;
 
 //
 // water acceleration
 //
-//      if (pmove.waterjumptime)
-//              Con_Printf ("wm->%f, %f, %f\n", pmove.velocity[0], pmove.velocity[1], pmove.velocity[2]);
-    PM_Accelerate(wishdir, wishspeed, movevars.wateraccelerate);
+//      if (pm->waterjumptime)
+//              Con_Printf ("wm->%f, %f, %f\n", pm->velocity[0], pm->velocity[1], pm->velocity[2]);
+    PM_Accelerate(pm, wishdir, wishspeed, pm->movevars.wateraccelerate);
 
 // assume it is a stair or a slope, so press down from stepheight above
-    VectorMA(pmove.origin, frametime, pmove.velocity, dest);
+    VectorMA(pm->origin, pm->frametime, pm->velocity, dest);
     VectorCopy(dest, start);
     start[2] += STEPSIZE + 1;
-    trace = PM_PlayerMove(start, dest);
+    trace = PM_PlayerMove(pm, start, dest);
     if (!trace.startsolid && !trace.allsolid)   // FIXME: check steep slope?
     {                           // walked up the step
-        VectorCopy(trace.endpos, pmove.origin);
+        VectorCopy(trace.endpos, pm->origin);
         return;
     }
 
-    PM_FlyMove();
-//      if (pmove.waterjumptime)
-//              Con_Printf ("<-wm%f, %f, %f\n", pmove.velocity[0], pmove.velocity[1], pmove.velocity[2]);
+    PM_FlyMove(pm);
+//      if (pm->waterjumptime)
+//              Con_Printf ("<-wm%f, %f, %f\n", pm->velocity[0], pm->velocity[1], pm->velocity[2]);
 }
 
 
@@ -481,7 +473,7 @@ PM_AirMove
 
 ===================
 */
-void PM_AirMove(void)
+void PM_AirMove(playermove_t * pm)
 {
     int i;
     vec3_t wishvel;
@@ -489,16 +481,16 @@ void PM_AirMove(void)
     vec3_t wishdir;
     float wishspeed;
 
-    fmove = pmove.cmd.forwardmove;
-    smove = pmove.cmd.sidemove;
+    fmove = pm->cmd.forwardmove;
+    smove = pm->cmd.sidemove;
 
-    forward[2] = 0;
-    right[2] = 0;
-    VectorNormalize(forward);
-    VectorNormalize(right);
+    pm->forward[2] = 0;
+    pm->right[2] = 0;
+    VectorNormalize(pm->forward);
+    VectorNormalize(pm->right);
 
     for (i = 0; i < 2; i++)
-        wishvel[i] = forward[i] * fmove + right[i] * smove;
+        wishvel[i] = pm->forward[i] * fmove + pm->right[i] * smove;
     wishvel[2] = 0;
 
     VectorCopy(wishvel, wishdir);
@@ -507,38 +499,38 @@ void PM_AirMove(void)
 //
 // clamp to server defined max speed
 //
-    if (wishspeed > movevars.maxspeed) {
-        VectorScale(wishvel, movevars.maxspeed / wishspeed, wishvel);
-        wishspeed = movevars.maxspeed;
+    if (wishspeed > pm->movevars.maxspeed) {
+        VectorScale(wishvel, pm->movevars.maxspeed / wishspeed, wishvel);
+        wishspeed = pm->movevars.maxspeed;
     }
-//      if (pmove.waterjumptime)
-//              Con_Printf ("am->%f, %f, %f\n", pmove.velocity[0], pmove.velocity[1], pmove.velocity[2]);
-
-    if (onground != -1) {
-        pmove.velocity[2] = 0;
-        PM_Accelerate(wishdir, wishspeed, movevars.accelerate);
-        pmove.velocity[2] -=
-            movevars.entgravity * movevars.gravity * frametime;
-        PM_GroundMove();
+//      if (pm->waterjumptime)
+//              Con_Printf ("am->%f, %f, %f\n", pm->velocity[0], pm->velocity[1], pm->velocity[2]);
+
+    if (pm->onground != -1) {
+        pm->velocity[2] = 0;
+        PM_Accelerate(pm, wishdir, wishspeed, pm->movevars.accelerate);
+        pm->velocity[2] -=
+            pm->movevars.entgravity * pm->movevars.gravity * pm->frametime;
+        PM_GroundMove(pm);
     } else {                    // not on ground, so little effect on velocity
-        PM_AirAccelerate(wishdir, wishspeed, movevars.accelerate);
+        PM_AirAccelerate(pm, wishdir, wishspeed, pm->movevars.accelerate);
 
         // add gravity
-        pmove.velocity[2] -=
-            movevars.entgravity * movevars.gravity * frametime;
+        pm->velocity[2] -=
+            pm->movevars.entgravity * pm->movevars.gravity * pm->frametime;
 
-        PM_FlyMove();
+        PM_FlyMove(pm);
 
     }
 
 //Con_Printf("airmove:vec: %4.2f %4.2f %4.2f\n",
-//                      pmove.velocity[0],
-//                      pmove.velocity[1],
-//                      pmove.velocity[2]);
+//                      pm->velocity[0],
+//                      pm->velocity[1],
+//                      pm->velocity[2]);
 //
 
-//      if (pmove.waterjumptime)
-//              Con_Printf ("<-am%f, %f, %f\n", pmove.velocity[0], pmove.velocity[1], pmove.velocity[2]);
+//      if (pm->waterjumptime)
+//              Con_Printf ("<-am%f, %f, %f\n", pm->velocity[0], pm->velocity[1], pm->velocity[2]);
 }
 
 
@@ -548,7 +540,7 @@ void PM_AirMove(void)
 PM_CatagorizePosition
 =============
 */
-void PM_CatagorizePosition(void)
+void PM_CatagorizePosition(playermove_t * pm)
 {
     vec3_t point;
     int cont;
@@ -558,51 +550,51 @@ void PM_CatagorizePosition(void)
 // is on ground
 
 // see if standing on something solid   
-    point[0] = pmove.origin[0];
-    point[1] = pmove.origin[1];
-    point[2] = pmove.origin[2] - 1;
-    if (pmove.velocity[2] > 180) {
-        onground = -1;
+    point[0] = pm->origin[0];
+    point[1] = pm->origin[1];
+    point[2] = pm->origin[2] - 1;
+    if (pm->velocity[2] > 180) {
+        pm->onground = -1;
     } else {
-        tr = PM_PlayerMove(pmove.origin, point);
+        tr = PM_PlayerMove(pm, pm->origin, point);
         if (tr.plane.normal[2] < 0.7)
-            onground = -1;      // too steep
+            pm->onground = -1;      // too steep
         else
-            onground = tr.ent;
-        if (onground != -1) {
-            groundplane = tr.plane;
-            pmove.waterjumptime = 0;
+            pm->onground = tr.ent;
+        if (pm->onground != -1) {
+            pm->groundplane = tr.plane;
+            pm->waterjumptime = 0;
             if (!tr.startsolid && !tr.allsolid)
-                VectorCopy(tr.endpos, pmove.origin);
+                VectorCopy(tr.endpos, pm->origin);
         }
         // standing on an entity other than the world
         if (tr.ent > 0) {
-            pmove.touchindex[pmove.numtouch] = tr.ent;
-            pmove.numtouch++;
+            pm->touchindex[pm->numtouch] = tr.ent;
+            pm->numtouch++;
         }
     }
 
 //
 // get waterlevel
 //
-    waterlevel = 0;
-    watertype = CONTENTS_EMPTY;
+    pm->waterlevel = 0;
+    pm->watertype = CONTENTS_EMPTY;
 
-    point[2] = pmove.origin[2] + player_mins[2] + 1;
-    cont = PM_PointContents(point);
+    point[2] = pm->origin[2] + player_mins[2] + 1;
+    cont = PM_PointContents(pm, point);
 
     if (cont <= CONTENTS_WATER) {
-        watertype = cont;
-        waterlevel = 1;
+        pm->watertype = cont;
+        pm->waterlevel = 1;
         point[2] =
-            pmove.origin[2] + (player_mins[2] + player_maxs[2]) * 0.5;
-        cont = PM_PointContents(point);
+            pm->origin[2] + (player_mins[2] + player_maxs[2]) * 0.5;
+        cont = PM_PointContents(pm, point);
         if (cont <= CONTENTS_WATER) {
-            waterlevel = 2;
-            point[2] = pmove.origin[2] + 22;
-            cont = PM_PointContents(point);
+            pm->waterlevel = 2;
+            point[2] = pm->origin[2] + 22;
+            cont = PM_PointContents(pm, point);
             if (cont <= CONTENTS_WATER)
-                waterlevel = 3;
+                pm->waterlevel = 3;
         }
     }
 }
@@ -613,46 +605,46 @@ void PM_CatagorizePosition(void)
 JumpButton
 =============
 */
-void JumpButton(void)
+void JumpButton(playermove_t * pm)
 {
-    if (pmove.dead) {
-        pmove.oldbuttons |= BUTTON_JUMP;        // don't jump again until released
+    if (pm->dead) {
+        pm->oldbuttons |= BUTTON_JUMP;        // don't jump again until released
         return;
     }
 
-    if (pmove.waterjumptime) {
-        pmove.waterjumptime -= frametime;
-        if (pmove.waterjumptime < 0)
-            pmove.waterjumptime = 0;
+    if (pm->waterjumptime) {
+        pm->waterjumptime -= pm->frametime;
+        if (pm->waterjumptime < 0)
+            pm->waterjumptime = 0;
         return;
     }
 
-    if (waterlevel >= 2) {      // swimming, not jumping
-        onground = -1;
+    if (pm->waterlevel >= 2) {      // swimming, not jumping
+        pm->onground = -1;
 
-        if (watertype == CONTENTS_WATER)
-            pmove.velocity[2] = 100;
-        else if (watertype == CONTENTS_SLIME)
-            pmove.velocity[2] = 80;
+        if (pm->watertype == CONTENTS_WATER)
+            pm->velocity[2] = 100;
+        else if (pm->watertype == CONTENTS_SLIME)
+            pm->velocity[2] = 80;
         else
-            pmove.velocity[2] = 50;
+            pm->velocity[2] = 50;
         return;
     }
 
-    if (onground == -1)
+    if (pm->onground == -1)
         return;                 // in air, so no effect
 
-    if (pmove.oldbuttons & BUTTON_JUMP)
+    if (pm->oldbuttons & BUTTON_JUMP)
         return;                 // don't pogo stick
 
     // jump fix, legend say this was by Tonik
-    if (pmove.velocity[2] < 0 && DotProduct(pmove.velocity, groundplane.normal) < -0.1)
-        PM_ClipVelocity (pmove.velocity, groundplane.normal, pmove.velocity, 1);
+    if (pm->velocity[2] < 0 && DotProduct(pm->velocity, pm->groundplane.normal) < -0.1)
+        PM_ClipVelocity (pm->velocity, pm->groundplane.normal, pm->velocity, 1);
 
-    onground = -1;
-    pmove.velocity[2] += 270;
+    pm->onground = -1;
+    pm->velocity[2] += 270;
 
-    pmove.oldbuttons |= BUTTON_JUMP;    // don't jump again until released
+    pm->oldbuttons |= BUTTON_JUMP;    // don't jump again until released
 }
 
 /*
@@ -660,80 +652,80 @@ void JumpButton(void)
 CheckWaterJump
 =============
 */
-void CheckWaterJump(void)
+void CheckWaterJump(playermove_t * pm)
 {
     vec3_t spot;
     int cont;
     vec3_t flatforward;
 
-    if (pmove.waterjumptime)
+    if (pm->waterjumptime)
         return;
 
     // ZOID, don't hop out if we just jumped in
-    if (pmove.velocity[2] < -180)
+    if (pm->velocity[2] < -180)
         return;                 // only hop out if we are moving up
 
     // see if near an edge
-    flatforward[0] = forward[0];
-    flatforward[1] = forward[1];
+    flatforward[0] = pm->forward[0];
+    flatforward[1] = pm->forward[1];
     flatforward[2] = 0;
     VectorNormalize(flatforward);
 
-    VectorMA(pmove.origin, 24, flatforward, spot);
+    VectorMA(pm->origin, 24, flatforward, spot);
     spot[2] += 8;
-    cont = PM_PointContents(spot);
+    cont = PM_PointContents(pm, spot);
     if (cont != CONTENTS_SOLID)
         return;
     spot[2] += 24;
-    cont = PM_PointContents(spot);
+    cont = PM_PointContents(pm, spot);
     if (cont != CONTENTS_EMPTY)
         return;
     // jump out of water
-    VectorScale(flatforward, 50, pmove.velocity);
-    pmove.velocity[2] = 310;
-    pmove.waterjumptime = 2;    // safety net
-    pmove.oldbuttons |= BUTTON_JUMP;    // don't jump again until released
+    VectorScale(flatforward, 50, pm->velocity);
+    pm->velocity[2] = 310;
+    pm->waterjumptime = 2;    // safety net
+    pm->oldbuttons |= BUTTON_JUMP;    // don't jump again until released
 }
 
 /*
 =================
 NudgePosition
 
-If pmove.origin is in a solid position,
+If pm->origin is in a solid position,
 try nudging slightly on all axis to
 allow for the cut precision of the net coordinates
 =================
 */
-void NudgePosition(void)
+void NudgePosition(playermove_t * pm)
 {
     vec3_t base;
     int x, y, z;
     int i;
     static int sign[3] = { 0, -1, 1 };
 
-    VectorCopy(pmove.origin, base);
+    VectorCopy(pm->origin, base);
 
     for (i = 0; i < 3; i++)
-        pmove.origin[i] = ((int) (pmove.origin[i] * 8)) * 0.125;
-//      pmove.origin[2] += 0.124;
+        pm->origin[i] = ((int) (pm->origin[i] * 8)) * 0.125;
+//      pm->origin[2] += 0.124;
 
-//      if (pmove.dead)
+//      if (pm->dead)
 //              return;         // might be a squished point, so don'y bother
-//      if (PM_TestPlayerPosition (pmove.origin) )
+//      if (PM_TestPlayerPosition (pm->origin) )
 //              return;
 
     for (z = 0; z <= 2; z++) {
         for (x = 0; x <= 2; x++) {
             for (y = 0; y <= 2; y++) {
-                pmove.origin[0] = base[0] + (sign[x] * 1.0 / 8);
-                pmove.origin[1] = base[1] + (sign[y] * 1.0 / 8);
-                pmove.origin[2] = base[2] + (sign[z] * 1.0 / 8);
-                if (PM_TestPlayerPosition(pmove.origin))
+                pm->origin[0] = base[0] + (sign[x] * 1.0 / 8);
+                pm->origin[1] = base[1] + (sign[y] * 1.0 / 8);
+                pm->origin[2] = base[2] + (sign[z] * 1.0 / 8);
+                if (PM_TestPlayerPosition(pm, pm->origin))
                     return;
             }
         }
     }
-    VectorCopy(base, pmove.origin);
+    VectorCopy(base, pm->origin);
 //      Con_DPrintf ("NudgePosition: stuck\n");
 }
 
@@ -742,7 +734,7 @@ void NudgePosition(void)
 SpectatorMove
 ===============
 */
-void SpectatorMove(void)
+void SpectatorMove(playermove_t * pm)
 {
     float speed, drop, friction, control, newspeed;
     float currentspeed, addspeed, accelspeed;
@@ -757,15 +749,15 @@ void SpectatorMove(void)
 
     // friction
 
-    speed = Length(pmove.velocity);
+    speed = Length(pm->velocity);
     if (speed < 1) {
-        VectorCopy(vec3_origin, pmove.velocity)
+        VectorCopy(vec3_origin, pm->velocity)
     } else {
         drop = 0;
 
-        friction = movevars.friction * 1.5;     // extra friction
-        control = speed < movevars.stopspeed ? movevars.stopspeed : speed;
-        drop += control * friction * frametime;
+        friction = pm->movevars.friction * 1.5;     // extra friction
+        control = speed < pm->movevars.stopspeed ? pm->movevars.stopspeed : speed;
+        drop += control * friction * pm->frametime;
 
         // scale the velocity
         newspeed = speed - drop;
@@ -773,19 +765,19 @@ void SpectatorMove(void)
             newspeed = 0;
         newspeed /= speed;
 
-        VectorScale(pmove.velocity, newspeed, pmove.velocity);
+        VectorScale(pm->velocity, newspeed, pm->velocity);
     }
 
     // accelerate
-    fmove = pmove.cmd.forwardmove;
-    smove = pmove.cmd.sidemove;
+    fmove = pm->cmd.forwardmove;
+    smove = pm->cmd.sidemove;
 
-    VectorNormalize(forward);
-    VectorNormalize(right);
+    VectorNormalize(pm->forward);
+    VectorNormalize(pm->right);
 
     for (i = 0; i < 3; i++)
-        wishvel[i] = forward[i] * fmove + right[i] * smove;
-    wishvel[2] += pmove.cmd.upmove;
+        wishvel[i] = pm->forward[i] * fmove + pm->right[i] * smove;
+    wishvel[2] += pm->cmd.upmove;
 
     VectorCopy(wishvel, wishdir);
     wishspeed = VectorNormalize(wishdir);
@@ -793,26 +785,26 @@ void SpectatorMove(void)
     //
     // clamp to server defined max speed
     //
-    if (wishspeed > movevars.spectatormaxspeed) {
-        VectorScale(wishvel, movevars.spectatormaxspeed / wishspeed,
+    if (wishspeed > pm->movevars.spectatormaxspeed) {
+        VectorScale(wishvel, pm->movevars.spectatormaxspeed / wishspeed,
                     wishvel);
-        wishspeed = movevars.spectatormaxspeed;
+        wishspeed = pm->movevars.spectatormaxspeed;
     }
 
-    currentspeed = DotProduct(pmove.velocity, wishdir);
+    currentspeed = DotProduct(pm->velocity, wishdir);
     addspeed = wishspeed - currentspeed;
     if (addspeed <= 0)
         return;
-    accelspeed = movevars.accelerate * frametime * wishspeed;
+    accelspeed = pm->movevars.accelerate * pm->frametime * wishspeed;
     if (accelspeed > addspeed)
         accelspeed = addspeed;
 
     for (i = 0; i < 3; i++)
-        pmove.velocity[i] += accelspeed * wishdir[i];
+        pm->velocity[i] += accelspeed * wishdir[i];
 
 
     // move
-    VectorMA(pmove.origin, frametime, pmove.velocity, pmove.origin);
+    VectorMA(pm->origin, pm->frametime, pm->velocity, pm->origin);
 }
 
 /*
@@ -823,51 +815,54 @@ Returns with origin, angles, and velocity modified in place.
 
 Numtouch and touchindex[] will be set if any of the physents
 were contacted during the move.
+
+Everything the move works with lives in pm, moves with different
+contexts can run at the same time.
 =============
 */
-void PlayerMove(void)
+void PlayerMove(playermove_t * pm)
 {
-    frametime = pmove.cmd.msec * 0.001;
-    pmove.numtouch = 0;
+    pm->frametime = pm->cmd.msec * 0.001;
+    pm->numtouch = 0;
 
-    AngleVectors(pmove.angles, forward, right, up);
+    AngleVectors(pm->angles, pm->forward, pm->right, pm->up);
 
-    if (pmove.spectator) {
-        SpectatorMove();
+    if (pm->spectator) {
+        SpectatorMove(pm);
         return;
     }
 
-    NudgePosition();
+    NudgePosition(pm);
 
     // take angles directly from command
-    VectorCopy(pmove.cmd.angles, pmove.angles);
+    VectorCopy(pm->cmd.angles, pm->angles);
 
     // set onground, watertype, and waterlevel
-    PM_CatagorizePosition();
+    PM_CatagorizePosition(pm);
 
-    if (waterlevel == 2)
-        CheckWaterJump();
+    if (pm->waterlevel == 2)
+        CheckWaterJump(pm);
 
-    if (pmove.velocity[2] < 0)
-        pmove.waterjumptime = 0;
+    if (pm->velocity[2] < 0)
+        pm->waterjumptime = 0;
 
-    if (pmove.cmd.buttons & BUTTON_JUMP)
-        JumpButton();
+    if (pm->cmd.buttons & BUTTON_JUMP)
+        JumpButton(pm);
     else
-        pmove.oldbuttons &= ~BUTTON_JUMP;
+        pm->oldbuttons &= ~BUTTON_JUMP;
 
-    PM_Friction();
+    PM_Friction(pm);
 
-    if (waterlevel >= 2)
-        PM_WaterMove();
+    if (pm->waterlevel >= 2)
+        PM_WaterMove(pm);
     else
-        PM_AirMove();
+        PM_AirMove(pm);
 
     // set onground, watertype, and waterlevel for final spot
-    PM_CatagorizePosition();
+    PM_CatagorizePosition(pm);
 
     // this is to make sure landing sound is not played twice
     // and falling damage is calculated correctly
-    if (!onground && pmove.velocity[2] < -300 && DotProduct(pmove.velocity, groundplane.normal) < -0.1)
-	PM_ClipVelocity (pmove.velocity, groundplane.normal, pmove.velocity, 1);
+    if (!pm->onground && pm->velocity[2] < -300 && DotProduct(pm->velocity, pm->groundplane.normal) < -0.1)
+	PM_ClipVelocity (pm->velocity, pm->groundplane.normal, pm->velocity, 1);
 }
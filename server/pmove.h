@@ -43,6 +43,19 @@ typedef struct {
 } physent_t;
 
 
+typedef struct {
+    float gravity;
+    float stopspeed;
+    float maxspeed;
+    float spectatormaxspeed;
+    float accelerate;
+    float airaccelerate;
+    float wateraccelerate;
+    float friction;
+    float waterfriction;
+    float entgravity;
+} movevars_t;
+
 typedef struct {
     int sequence;               // just for debugging prints
 
@@ -61,37 +74,32 @@ typedef struct {
 
     // input
     usercmd_t cmd;
+    movevars_t movevars;
 
     // results
     int numtouch;
     int touchindex[MAX_PHYSENTS];
+    int onground;
+    int waterlevel;
+    int watertype;
+
+    // used during the move
+    float frametime;
+    vec3_t forward, right, up;
+    pmplane_t groundplane;
+    hull_t box_hull;
+    mplane_t box_planes[6];
 } playermove_t;
 
-typedef struct {
-    float gravity;
-    float stopspeed;
-    float maxspeed;
-    float spectatormaxspeed;
-    float accelerate;
-    float airaccelerate;
-    float wateraccelerate;
-    float friction;
-    float waterfriction;
-    float entgravity;
-} movevars_t;
-
 
 extern movevars_t movevars;
 extern playermove_t pmove;
-extern int onground;
-extern int waterlevel;
-extern int watertype;
 
-void PlayerMove(void);
+void PlayerMove(playermove_t * pm);
 void Pmove_Init(void);
 
 int PM_HullPointContents(hull_t * hull, int num, vec3_t p);
 
-int PM_PointContents(vec3_t point);
-qboolean PM_TestPlayerPosition(vec3_t point);
-pmtrace_t PM_PlayerMove(vec3_t start, vec3_t stop);
+int PM_PointContents(playermove_t * pm, vec3_t point);
+qboolean PM_TestPlayerPosition(playermove_t * pm, vec3_t point);
+pmtrace_t PM_PlayerMove(playermove_t * pm, vec3_t start, vec3_t stop);
@@ -19,31 +19,23 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 #include "qwsvdef.h"
 
-static hull_t box_hull;
 static dclipnode_t box_clipnodes[6];
-static mplane_t box_planes[6];
 
 extern vec3_t player_mins;
 extern vec3_t player_maxs;
 
 /*
 ===================
-PM_InitBoxHull
+PM_InitBoxClipnodes
 
-Set up the planes and clipnodes so that the six floats of a bounding box
-can just be stored out and get a proper hull_t structure.
+The clipnodes of a box hull never change, every playermove_t shares them
 ===================
 */
-void PM_InitBoxHull(void)
+void PM_InitBoxClipnodes(void)
 {
     int i;
     int side;
 
-    box_hull.clipnodes = box_clipnodes;
-    box_hull.planes = box_planes;
-    box_hull.firstclipnode = 0;
-    box_hull.lastclipnode = 5;
-
     for (i = 0; i < 6; i++) {
         box_clipnodes[i].planenum = i;
 
@@ -54,11 +46,32 @@ void PM_InitBoxHull(void)
             box_clipnodes[i].children[side ^ 1] = i + 1;
         else
             box_clipnodes[i].children[side ^ 1] = CONTENTS_SOLID;
-
-        box_planes[i].type = i >> 1;
-        box_planes[i].normal[i >> 1] = 1;
     }
+}
+
+/*
+===================
+PM_InitBoxHull
 
+Set up the planes and clipnodes so that the six floats of a bounding box
+can just be stored out and get a proper hull_t structure.
+===================
+*/
+static void PM_InitBoxHull(playermove_t * pm)
+{
+    int i;
+
+    pm->box_hull.clipnodes = box_clipnodes;
+    pm->box_hull.planes = pm->box_planes;
+    pm->box_hull.firstclipnode = 0;
+    pm->box_hull.lastclipnode = 5;
+    pm->box_hull.nodes = NULL;
+
+    memset(pm->box_planes, 0, sizeof(pm->box_planes));
+    for (i = 0; i < 6; i++) {
+        pm->box_planes[i].type = i >> 1;
+        pm->box_planes[i].normal[i >> 1] = 1;
+    }
 }
 
 
@@ -70,16 +83,20 @@ To keep everything totally uniform, bounding boxes are turned into small
 BSP trees instead of being compared directly.
 ===================
 */
-hull_t *PM_HullForBox(vec3_t mins, vec3_t maxs)
+hull_t *PM_HullForBox(playermove_t * pm, vec3_t mins, vec3_t maxs)
 {
-    box_planes[0].dist = maxs[0];
-    box_planes[1].dist = mins[0];
-    box_planes[2].dist = maxs[1];
-    box_planes[3].dist = mins[1];
-    box_planes[4].dist = maxs[2];
-    box_planes[5].dist = mins[2];
-
-    return &box_hull;
+    // the context may be new or a copy of another one
+    if (pm->box_hull.planes != pm->box_planes)
+        PM_InitBoxHull(pm);
+
+    pm->box_planes[0].dist = maxs[0];
+    pm->box_planes[1].dist = mins[0];
+    pm->box_planes[2].dist = maxs[1];
+    pm->box_planes[3].dist = mins[1];
+    pm->box_planes[4].dist = maxs[2];
+    pm->box_planes[5].dist = mins[2];
+
+    return &pm->box_hull;
 }
 
 
@@ -121,7 +138,7 @@ PM_PointContents
 
 ==================
 */
-int PM_PointContents(vec3_t p)
+int PM_PointContents(playermove_t * pm, vec3_t p)
 {
     float d;
     dclipnode_t *node;
@@ -129,7 +146,9 @@ int PM_PointContents(vec3_t p)
     hull_t *hull;
     int num;
 
-    hull = &pmove.physents[0].model->hulls[0];
+    hull = &pm->physents[0].model->hulls[0];
+    if (hull->nodes)
+        return Mod_HullNodeContents(hull, hull->firstnode, p);
 
     num = hull->firstclipnode;
 
@@ -283,9 +302,9 @@ qboolean PM_RecursiveHullCheck(hull_t * hull, int num, float p1f,
            == CONTENTS_SOLID) { // shouldn't really happen, but does occasionally
         frac -= 0.1;
         if (frac < 0) {
+            // no printing here, moves can run on the worker threads
             trace->fraction = midf;
             VectorCopy(mid, trace->endpos);
-            Con_DPrintf("backup past 0\n");
             return false;
         }
         midf = p1f + (p2f - p1f) * frac;
@@ -307,40 +326,82 @@ PM_TestPlayerPosition
 Returns false if the given player position is not valid (in solid)
 ================
 */
-qboolean PM_TestPlayerPosition(vec3_t pos)
+qboolean PM_TestPlayerPosition(playermove_t * pm, vec3_t pos)
 {
     int i;
     physent_t *pe;
     vec3_t mins, maxs, test;
     hull_t *hull;
 
-    for (i = 0; i < pmove.numphysent; i++) {
-        pe = &pmove.physents[i];
+    for (i = 0; i < pm->numphysent; i++) {
+        pe = &pm->physents[i];
         // get the clipping hull
         if (pe->model)
-            hull = &pmove.physents[i].model->hulls[1];
+            hull = &pm->physents[i].model->hulls[1];
         else {
             VectorSubtract(pe->mins, player_maxs, mins);
             VectorSubtract(pe->maxs, player_mins, maxs);
-            hull = PM_HullForBox(mins, maxs);
+            hull = PM_HullForBox(pm, mins, maxs);
         }
 
         VectorSubtract(pos, pe->origin, test);
 
-        if (PM_HullPointContents(hull, hull->firstclipnode, test) ==
-            CONTENTS_SOLID)
+        if (hull->nodes) {
+            if (Mod_HullNodeContents(hull, hull->firstnode, test) ==
+                CONTENTS_SOLID)
+                return false;
+        } else if (PM_HullPointContents(hull, hull->firstclipnode, test) ==
+                   CONTENTS_SOLID)
             return false;
     }
 
     return true;
 }
 
+/*
+================
+PM_TraceHull
+
+Traces through the packed nodes when the hull has them
+================
+*/
+static void PM_TraceHull(hull_t * hull, vec3_t p1, vec3_t p2,
+                         pmtrace_t * trace)
+{
+    hulltrace_t t;
+
+    if (hull->nodes) {
+        t.allsolid = trace->allsolid;
+        t.startsolid = trace->startsolid;
+        t.inopen = trace->inopen;
+        t.inwater = trace->inwater;
+        t.fraction = trace->fraction;
+        VectorCopy(trace->endpos, t.endpos);
+        VectorCopy(trace->plane.normal, t.normal);
+        t.dist = trace->plane.dist;
+
+        if (Mod_TraceHull(hull, p1, p2, &t)) {
+            trace->allsolid = t.allsolid;
+            trace->startsolid = t.startsolid;
+            trace->inopen = t.inopen;
+            trace->inwater = t.inwater;
+            trace->fraction = t.fraction;
+            VectorCopy(t.endpos, trace->endpos);
+            VectorCopy(t.normal, trace->plane.normal);
+            trace->plane.dist = t.dist;
+            return;
+        }
+    }
+
+    PM_RecursiveHullCheck(hull, hull->firstclipnode, 0, 1, p1, p2, trace);
+}
+
 /*
 ================
 PM_PlayerMove
 ================
 */
-pmtrace_t PM_PlayerMove(vec3_t start, vec3_t end)
+pmtrace_t PM_PlayerMove(playermove_t * pm, vec3_t start, vec3_t end)
 {
     pmtrace_t trace, total;
     vec3_t offset;
@@ -356,15 +417,15 @@ pmtrace_t PM_PlayerMove(vec3_t start, vec3_t end)
     total.ent = -1;
     VectorCopy(end, total.endpos);
 
-    for (i = 0; i < pmove.numphysent; i++) {
-        pe = &pmove.physents[i];
+    for (i = 0; i < pm->numphysent; i++) {
+        pe = &pm->physents[i];
         // get the clipping hull
         if (pe->model)
-            hull = &pmove.physents[i].model->hulls[1];
+            hull = &pm->physents[i].model->hulls[1];
         else {
             VectorSubtract(pe->mins, player_maxs, mins);
             VectorSubtract(pe->maxs, player_mins, maxs);
-            hull = PM_HullForBox(mins, maxs);
+            hull = PM_HullForBox(pm, mins, maxs);
         }
 
         // PM_HullForEntity (ent, mins, maxs, offset);
@@ -381,8 +442,7 @@ pmtrace_t PM_PlayerMove(vec3_t start, vec3_t end)
         VectorCopy(end, trace.endpos);
 
         // trace a line through the apropriate clipping hull
-        PM_RecursiveHullCheck(hull, hull->firstclipnode, 0, 1, start_l,
-                              end_l, &trace);
+        PM_TraceHull(hull, start_l, end_l, &trace);
 
         if (trace.allsolid)
             trace.startsolid = true;
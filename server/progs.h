@@ -40,6 +40,9 @@ typedef struct edict_s {
 
     entity_state_t baseline;
 
+    int netdirty;               // ND_* bits changed during netframe
+    int netframe;               // sv_netframe of the last change
+
     float freetime;             // sv.time when the object was freed
     entvars_t v;                // C exported fields from progs
 // other fields from progs come immediately after
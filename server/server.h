@@ -106,6 +106,7 @@ typedef struct {
     // reply
     double senttime;
     float ping_time;
+    int netframe;               // sv_netframe when the entities were built
     packet_entities_t entities;
 } client_frame_t;
 
@@ -185,6 +186,7 @@ typedef struct client_s {
     int chokecount;
     int delta_sequence;         // -1 = no compression
     netchan_t netchan;
+    struct client_s *hashnext;  // same bucket, see SV_ClientForAddress
 } client_t;
 
 // a client can leave the server in one of four ways:
@@ -200,12 +202,32 @@ typedef struct client_s {
 typedef struct {
     double active;
     double idle;
+    double gc;                  // time spent stepping the Lua collector
+    double frametimes[STATFRAMES];
     int count;
     int packets;
+    int vec3allocs;             // vec3_t userdata created by progs
+    int progcalls;              // PR_ExecuteProgram calls
+    int physents;               // entities run by SV_Physics
+    int luaallocs;              // blocks handed out to Lua
+    int luabytes;
+    int deltas;                 // packet entities compared to the old frame
+    int deltaskips;             // ... and skipped as unchanged
+    int syscalls;               // socket reads and writes
 
     double latched_active;
     double latched_idle;
+    double latched_gc;
+    double latched_p99;         // 99th percentile frame time
     int latched_packets;
+    int latched_vec3allocs;
+    int latched_progcalls;
+    int latched_physents;
+    int latched_luaallocs;
+    int latched_luabytes;
+    int latched_deltas;
+    int latched_deltaskips;
+    int latched_syscalls;
 } svstats_t;
 
 // MAX_CHALLENGES is made large to prevent a denial
@@ -341,6 +363,7 @@ extern FILE *sv_fraglogfile;
 //
 void SV_Shutdown(void);
 void SV_Frame(float time);
+void SV_PacketFrame(float time);
 void SV_FinalMessage(char *message);
 void SV_DropClient(client_t * drop);
 
@@ -368,6 +391,11 @@ void SV_SendServerinfo(client_t * client);
 void SV_ExtractFromUserinfo(client_t * cl);
 
 
+void SV_HashClient(client_t * cl);
+void SV_UnhashClient(client_t * cl);
+client_t *SV_ClientForAddress(netadr_t adr, int qport);
+void SV_ClientHash_f(void);
+
 void Master_Heartbeat(void);
 void Master_Packet(void);
 
@@ -383,6 +411,8 @@ void SV_FlushSignon(void);
 //
 void SV_ProgStartFrame(void);
 void SV_Physics(void);
+void SV_ClearThinks(void);
+void SV_ScheduleThink(edict_t * ent);
 void SV_CheckVelocity(edict_t * ent);
 void SV_AddGravity(edict_t * ent, float scale);
 qboolean SV_RunThink(edict_t * ent);
@@ -391,6 +421,36 @@ void SV_RunNewmis(void);
 void SV_Impact(edict_t * e1, edict_t * e2);
 void SV_SetMoveVars(void);
 
+//
+// sv_pool.c
+//
+#define	MAX_POOLTHREADS	16
+
+// globals a pool job writes to have to be one per thread
+#ifdef _MSC_VER
+#define	THREADLOCAL	__declspec(thread)
+#else
+#define	THREADLOCAL	__thread
+#endif
+
+typedef void (*pooljob_t) (int index, int thread);
+
+extern cvar_t sv_threads;
+
+int SV_PoolThreads(void);
+void SV_RunPool(pooljob_t job, int count);
+
+//
+// sv_entprof.c
+//
+typedef enum { EP_THINK, EP_TOUCH, EP_BLOCKED, NUM_EP_KINDS } entprofkind_t;
+
+extern cvar_t sv_entprofile;
+
+void SV_EntCall(edict_t * ent, func_t fn, entprofkind_t kind);
+void SV_EntProfileLatch(void);
+void SV_EntProfile_f(void);
+
 //
 // sv_send.c
 //
@@ -409,14 +469,19 @@ void SV_FindModelNumbers(void);
 // sv_user.c
 //
 void SV_ExecuteClientMessage(client_t * cl);
+void SV_RunMoves(void);
 void SV_UserInit(void);
 void SV_TogglePause(const char *msg);
+void SV_InvalidatePmoveEnts(void);
+void SV_LinkPmoveEnt(edict_t * ent);
+void SV_UnlinkPmoveEnt(edict_t * ent);
+void SV_PmoveBench_f(void);
 
 
 //
 // svonly.c
 //
-typedef enum { RD_NONE, RD_CLIENT, RD_PACKET } redirect_t;
+typedef enum { RD_NONE, RD_CLIENT, RD_PACKET, RD_STATUS } redirect_t;
 void SV_BeginRedirect(redirect_t rd);
 void SV_EndRedirect(void);
 
@@ -428,7 +493,25 @@ void SV_Status_f(void);
 //
 // sv_ents.c
 //
+
+// network fields of an edict, see SV_MarkNetDirty
+#define	ND_ORIGIN	1
+#define	ND_ANGLES	2
+#define	ND_MODEL	4
+#define	ND_FRAME	8
+#define	ND_SKIN		16
+#define	ND_EFFECTS	32
+#define	ND_COLORMAP	64
+#define	ND_ALL		127
+
+extern int sv_netframe;
+extern cvar_t sv_netdirty;
+extern cvar_t sv_snapshot;
+
+void SV_MarkNetDirty(edict_t * ent, int bits);
+void SV_BuildSnapshot(void);
 void SV_WriteEntitiesToClient(client_t * client, sizebuf_t * msg);
+void SV_SnapBench_f(void);
 
 //
 // sv_nchan.c
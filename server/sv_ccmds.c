@@ -382,7 +382,25 @@ void SV_Status_f(void)
     Con_Printf("net address      : %s\n", NET_AdrToString(net_local_adr));
     Con_Printf("cpu utilization  : %3i%%\n", (int) cpu);
     Con_Printf("avg response time: %i ms\n", (int) avg);
+    Con_Printf("p99 frame time   : %5.2f ms\n", 1000 * svs.stats.latched_p99);
     Con_Printf("packets/frame    : %5.2f (%d)\n", pak, num_prstr);
+    Con_Printf("net syscalls/frame: %5.2f\n",
+               (float) svs.stats.latched_syscalls / STATFRAMES);
+    Con_Printf("physics ents/frame: %5.2f\n",
+               (float) svs.stats.latched_physents / STATFRAMES);
+#ifdef WITH_LUA
+    Con_Printf("vec3 allocs/frame: %5.2f\n",
+               (float) svs.stats.latched_vec3allocs / STATFRAMES);
+    Con_Printf("progs calls/frame: %5.2f\n",
+               (float) svs.stats.latched_progcalls / STATFRAMES);
+    Con_Printf("lua allocs/frame : %5.2f\n",
+               (float) svs.stats.latched_luaallocs / STATFRAMES);
+    Con_Printf("lua gc time/frame: %5.3f ms\n",
+               1000 * svs.stats.latched_gc / STATFRAMES);
+    Con_Printf("unchanged deltas : %5.1f%%\n", svs.stats.latched_deltas ?
+               100.0 * svs.stats.latched_deltaskips /
+               svs.stats.latched_deltas : 0);
+#endif
 
 // min fps lat drp
     if (sv_redirected != RD_NONE) {
@@ -848,6 +866,12 @@ void SV_InitOperatorCommands(void)
     Cmd_AddCommand("snap", SV_Snap_f);
     Cmd_AddCommand("snapall", SV_SnapAll_f);
     Cmd_AddCommand("kick", SV_Kick_f);
+    Cmd_AddCommand("entprofile", SV_EntProfile_f);
+    Cmd_AddCommand("snapbench", SV_SnapBench_f);
+    Cmd_AddCommand("clienthash", SV_ClientHash_f);
+    Cmd_AddCommand("areastats", SV_AreaStats_f);
+    Cmd_AddCommand("pmovebench", SV_PmoveBench_f);
+    Cmd_AddCommand("tracebench", SV_TraceBench_f);
     Cmd_AddCommand("status", SV_Status_f);
 
     Cmd_AddCommand("map", SV_Map_f);
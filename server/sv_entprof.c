@@ -0,0 +1,250 @@
+// sv_entprof.c -- progs cost by classname
+
+/*
+   think, touch and blocked calls made by the engine go through SV_EntCall,
+   which charges their wall time to the classname of the entity they run
+   for.  a touch fired from inside a think (a rocket's move hitting a
+   trigger) is charged to the toucher only, each entry holds the time spent
+   in its own calls.
+
+   the counters are latched every STATFRAMES frames along with svs.stats,
+   entprofile shows the last complete window.  the timing costs two clock
+   reads and a classname lookup per call, so it is off unless
+   sv_entprofile is set.
+*/
+
+#include "qwsvdef.h"
+
+#define MAX_EP_CLASSES  256     // power of two
+#define EP_NAMELEN      64
+#define EP_DEPTH        32
+
+typedef struct {
+    char name[EP_NAMELEN];
+    int calls[NUM_EP_KINDS];
+    double time[NUM_EP_KINDS];
+    int latched_calls[NUM_EP_KINDS];
+    double latched_time[NUM_EP_KINDS];
+} entprof_t;
+
+static char *ep_kindnames[NUM_EP_KINDS] = { "think", "touch", "blocked" };
+
+cvar_t sv_entprofile = { "sv_entprofile", "0" };
+
+static entprof_t ep_classes[MAX_EP_CLASSES];
+static entprof_t ep_overflow = { "(other)" };
+
+// time spent in nested calls, taken off their parent
+static double ep_child[EP_DEPTH];
+static int ep_depth;
+
+static entprof_t *SV_EntProfileClass(char *name)
+{
+    unsigned h;
+    char *s;
+    int i;
+
+    if (!*name)
+        name = "(none)";
+
+    for (h = 0, s = name; *s; s++)
+        h = h * 31 + (byte)*s;
+
+    for (i = 0; i < MAX_EP_CLASSES; i++) {
+        h &= MAX_EP_CLASSES - 1;
+        if (!ep_classes[h].name[0]) {
+            snprintf(ep_classes[h].name, EP_NAMELEN, "%s", name);
+            return &ep_classes[h];
+        }
+        if (!strcmp(ep_classes[h].name, name))
+            return &ep_classes[h];
+        h++;
+    }
+
+    return &ep_overflow;
+}
+
+/*
+=================
+SV_EntCall
+
+Runs fn for ent, charging the time to ent's classname.  The caller sets
+self and other as usual.
+=================
+*/
+void SV_EntCall(edict_t * ent, func_t fn, entprofkind_t kind)
+{
+    entprof_t *ep;
+    double start, dt;
+
+    if (!sv_entprofile.value) {
+        PR_ExecuteProgram(fn);
+        return;
+    }
+
+    // look the class up first, the call may rename or remove ent
+    ep = SV_EntProfileClass(PR_GetString(ent->v.classname));
+
+    if (ep_depth < EP_DEPTH)
+        ep_child[ep_depth] = 0;
+    ep_depth++;
+
+    start = Sys_DoubleTime();
+    PR_ExecuteProgram(fn);
+    dt = Sys_DoubleTime() - start;
+
+    ep_depth--;
+    if (ep_depth > 0 && ep_depth <= EP_DEPTH)
+        ep_child[ep_depth - 1] += dt;
+    if (ep_depth < EP_DEPTH)
+        dt -= ep_child[ep_depth];
+
+    ep->calls[kind]++;
+    ep->time[kind] += dt;
+}
+
+static void SV_EntProfileLatchClass(entprof_t * ep)
+{
+    int k;
+
+    for (k = 0; k < NUM_EP_KINDS; k++) {
+        ep->latched_calls[k] = ep->calls[k];
+        ep->latched_time[k] = ep->time[k];
+        ep->calls[k] = 0;
+        ep->time[k] = 0;
+    }
+}
+
+/*
+=================
+SV_EntProfileLatch
+
+Called from SV_Frame at the end of each stats window
+=================
+*/
+void SV_EntProfileLatch(void)
+{
+    int i;
+
+    for (i = 0; i < MAX_EP_CLASSES; i++)
+        if (ep_classes[i].name[0])
+            SV_EntProfileLatchClass(&ep_classes[i]);
+    SV_EntProfileLatchClass(&ep_overflow);
+
+    // no calls are in progress between frames
+    ep_depth = 0;
+}
+
+static double SV_EntProfileTotal(entprof_t * ep)
+{
+    double total;
+    int k;
+
+    for (total = 0, k = 0; k < NUM_EP_KINDS; k++)
+        total += ep->latched_time[k];
+
+    return total;
+}
+
+static int SV_CompareEntProfile(const void *a, const void *b)
+{
+    double d = SV_EntProfileTotal(*(entprof_t **)b) -
+        SV_EntProfileTotal(*(entprof_t **)a);
+
+    return d < 0 ? -1 : d > 0;
+}
+
+// returns the classes that ran in the last window, most expensive first
+static int SV_EntProfileSorted(entprof_t ** sorted)
+{
+    int i, k, n;
+
+    for (i = n = 0; i <= MAX_EP_CLASSES; i++) {
+        entprof_t *ep = i < MAX_EP_CLASSES ? &ep_classes[i] : &ep_overflow;
+
+        for (k = 0; k < NUM_EP_KINDS; k++)
+            if (ep->latched_calls[k])
+                break;
+        if (k < NUM_EP_KINDS)
+            sorted[n++] = ep;
+    }
+    qsort(sorted, n, sizeof(sorted[0]), SV_CompareEntProfile);
+
+    return n;
+}
+
+static void SV_EntProfileCSV(char *name)
+{
+    static entprof_t *sorted[MAX_EP_CLASSES + 1];
+    char *path;
+    FILE *f;
+    int i, k, n;
+
+    path = va("%s/%s", com_gamedir, name);
+    COM_CreatePath(path);
+
+    f = fopen(path, "w");
+    if (!f) {
+        Con_Printf("Couldn't write %s\n", path);
+        return;
+    }
+
+    n = SV_EntProfileSorted(sorted);
+
+    fprintf(f, "classname");
+    for (k = 0; k < NUM_EP_KINDS; k++)
+        fprintf(f, ",%s_calls,%s_ms", ep_kindnames[k], ep_kindnames[k]);
+    fprintf(f, ",total_ms,frames\n");
+
+    for (i = 0; i < n; i++) {
+        fprintf(f, "%s", sorted[i]->name);
+        for (k = 0; k < NUM_EP_KINDS; k++)
+            fprintf(f, ",%i,%.3f", sorted[i]->latched_calls[k],
+                    sorted[i]->latched_time[k] * 1000);
+        fprintf(f, ",%.3f,%i\n", SV_EntProfileTotal(sorted[i]) * 1000,
+                STATFRAMES);
+    }
+
+    fclose(f);
+    Con_Printf("Wrote %i classes to %s\n", n, path);
+}
+
+/*
+=================
+SV_EntProfile_f
+
+entprofile [lines] | csv [file]
+=================
+*/
+void SV_EntProfile_f(void)
+{
+    static entprof_t *sorted[MAX_EP_CLASSES + 1];
+    entprof_t *ep;
+    int i, n, count;
+
+    if (Cmd_Argc() > 1 && !strcmp(Cmd_Argv(1), "csv")) {
+        SV_EntProfileCSV(Cmd_Argc() > 2 ? Cmd_Argv(2) : "entprofile.csv");
+        return;
+    }
+
+    if (!sv_entprofile.value)
+        Con_Printf("sv_entprofile is off, set it to 1 to collect\n");
+
+    count = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : 15;
+    n = SV_EntProfileSorted(sorted);
+
+    Con_Printf("progs time by classname over the last %i frames\n",
+               STATFRAMES);
+    Con_Printf("ms/frame   think        touch        blocked      classname\n");
+    for (i = 0; i < n && i < count; i++) {
+        ep = sorted[i];
+        Con_Printf("%8.3f %5i %6.2f %5i %6.2f %5i %6.2f  %s\n",
+                   SV_EntProfileTotal(ep) * 1000 / STATFRAMES,
+                   ep->latched_calls[EP_THINK],
+                   ep->latched_time[EP_THINK] * 1000,
+                   ep->latched_calls[EP_TOUCH],
+                   ep->latched_time[EP_TOUCH] * 1000,
+                   ep->latched_calls[EP_BLOCKED],
+                   ep->latched_time[EP_BLOCKED] * 1000, ep->name);
+    }
+}
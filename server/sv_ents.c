@@ -31,8 +31,9 @@ crosses a waterline.
 =============================================================================
 */
 
-int fatbytes;
-byte fatpvs[MAX_MAP_LEAFS / 8];
+// client datagrams can be built on pool threads, see SV_SendClientMessages
+THREADLOCAL int fatbytes;
+THREADLOCAL byte fatpvs[MAX_MAP_LEAFS / 8];
 
 void SV_AddToFatPVS(vec3_t org, mnode_t * node)
 {
@@ -86,8 +87,8 @@ byte *SV_FatPVS(vec3_t org)
 // because there can be a lot of nails, there is a special
 // network protocol for them
 #define	MAX_NAILS	32
-edict_t *nails[MAX_NAILS];
-int numnails;
+THREADLOCAL edict_t *nails[MAX_NAILS];
+THREADLOCAL int numnails;
 
 extern int sv_nailmodel, sv_supernailmodel, sv_playermodel;
 
@@ -139,16 +140,69 @@ void SV_EmitNailUpdate(sizebuf_t * msg)
 //=============================================================================
 
 
+/*
+=============================================================================
+
+Network fields of edicts are tracked as they are written, from the Lua
+field setters and from the C physics.  Each edict remembers the ND_* bits
+that changed and the sv_netframe they changed in.  sv_netframe advances
+once per SV_SendClientMessages, so an edict whose netframe is older than
+the frame a client deltas from is exactly what that client already has.
+
+QuakeC writes fields straight into memory, nothing is tracked without Lua.
+
+=============================================================================
+*/
+
+int sv_netframe;
+
+cvar_t sv_netdirty = { "sv_netdirty", "1" };
+
+void SV_MarkNetDirty(edict_t * ent, int bits)
+{
+    if (ent->netframe != sv_netframe) {
+        ent->netframe = sv_netframe;
+        ent->netdirty = 0;
+    }
+    ent->netdirty |= bits;
+}
+
+/*
+==================
+SV_NetChanges
+
+Returns the ND_* bits that may differ between the entity as the client got
+it in frame and as it is now
+==================
+*/
+static int SV_NetChanges(edict_t * ent, client_frame_t * frame)
+{
+#ifdef WITH_LUA
+    if (!sv_netdirty.value)
+        return ND_ALL;
+
+    if (ent->netframe < frame->netframe)
+        return 0;               // untouched since the frame was built
+
+    // everything written since then is still in netdirty
+    if (ent->netframe == frame->netframe)
+        return ent->netdirty;
+#endif
+
+    return ND_ALL;
+}
+
 /*
 ==================
 SV_WriteDelta
 
 Writes part of a packetentities message.
-Can delta from either a baseline or a previous packet_entity
+Can delta from either a baseline or a previous packet_entity,
+only the ND_* fields are compared.
 ==================
 */
 void SV_WriteDelta(entity_state_t * from, entity_state_t * to,
-                   sizebuf_t * msg, qboolean force)
+                   sizebuf_t * msg, qboolean force, int fields)
 {
     int bits;
     int i;
@@ -157,34 +211,38 @@ void SV_WriteDelta(entity_state_t * from, entity_state_t * to,
 // send an update
     bits = 0;
 
-    for (i = 0; i < 3; i++) {
-        miss = to->origin[i] - from->origin[i];
-        if (miss < -0.1 || miss > 0.1)
-            bits |= U_ORIGIN1 << i;
+    if (fields & ND_ORIGIN) {
+        for (i = 0; i < 3; i++) {
+            miss = to->origin[i] - from->origin[i];
+            if (miss < -0.1 || miss > 0.1)
+                bits |= U_ORIGIN1 << i;
+        }
     }
 
-    if (to->angles[0] != from->angles[0])
-        bits |= U_ANGLE1;
+    if (fields & ND_ANGLES) {
+        if (to->angles[0] != from->angles[0])
+            bits |= U_ANGLE1;
 
-    if (to->angles[1] != from->angles[1])
-        bits |= U_ANGLE2;
+        if (to->angles[1] != from->angles[1])
+            bits |= U_ANGLE2;
 
-    if (to->angles[2] != from->angles[2])
-        bits |= U_ANGLE3;
+        if (to->angles[2] != from->angles[2])
+            bits |= U_ANGLE3;
+    }
 
-    if (to->colormap != from->colormap)
+    if ((fields & ND_COLORMAP) && to->colormap != from->colormap)
         bits |= U_COLORMAP;
 
-    if (to->skinnum != from->skinnum)
+    if ((fields & ND_SKIN) && to->skinnum != from->skinnum)
         bits |= U_SKIN;
 
-    if (to->frame != from->frame)
+    if ((fields & ND_FRAME) && to->frame != from->frame)
         bits |= U_FRAME;
 
-    if (to->effects != from->effects)
+    if ((fields & ND_EFFECTS) && to->effects != from->effects)
         bits |= U_EFFECTS;
 
-    if (to->modelindex != from->modelindex)
+    if ((fields & ND_MODEL) && to->modelindex != from->modelindex)
         bits |= U_MODEL;
 
     if (bits & 511)
@@ -251,6 +309,8 @@ void SV_EmitPacketEntities(client_t * client, packet_entities_t * to,
     int oldindex, newindex;
     int oldnum, newnum;
     int oldmax;
+    int fields;
+    int deltas, deltaskips;
 
     // this is the frame that we are going to delta update from
     if (client->delta_sequence != -1) {
@@ -262,6 +322,7 @@ void SV_EmitPacketEntities(client_t * client, packet_entities_t * to,
         MSG_WriteByte(msg, client->delta_sequence);
     } else {
         oldmax = 0;             // no delta update
+        fromframe = NULL;
         from = NULL;
 
         MSG_WriteByte(msg, svc_packetentities);
@@ -269,6 +330,7 @@ void SV_EmitPacketEntities(client_t * client, packet_entities_t * to,
 
     newindex = 0;
     oldindex = 0;
+    deltas = deltaskips = 0;
 //Con_Printf ("---%i to %i ----\n", client->delta_sequence & UPDATE_MASK
 //                      , client->netchan.outgoing_sequence & UPDATE_MASK);
     while (newindex < to->num_entities || oldindex < oldmax) {
@@ -280,8 +342,13 @@ void SV_EmitPacketEntities(client_t * client, packet_entities_t * to,
 
         if (newnum == oldnum) { // delta update from old position
 //Con_Printf ("delta %i\n", newnum);
-            SV_WriteDelta(&from->entities[oldindex],
-                          &to->entities[newindex], msg, false);
+            fields = SV_NetChanges(EDICT_NUM(newnum), fromframe);
+            deltas++;
+            if (fields)
+                SV_WriteDelta(&from->entities[oldindex],
+                              &to->entities[newindex], msg, false, fields);
+            else
+                deltaskips++;
             oldindex++;
             newindex++;
             continue;
@@ -291,7 +358,7 @@ void SV_EmitPacketEntities(client_t * client, packet_entities_t * to,
             ent = EDICT_NUM(newnum);
 //Con_Printf ("baseline %i\n", newnum);
             SV_WriteDelta(&ent->baseline, &to->entities[newindex], msg,
-                          true);
+                          true, ND_ALL);
             newindex++;
             continue;
         }
@@ -305,6 +372,12 @@ void SV_EmitPacketEntities(client_t * client, packet_entities_t * to,
     }
 
     MSG_WriteShort(msg, 0);     // end of packetentities
+
+    // this can run on several threads at once
+    if (deltas) {
+        __sync_fetch_and_add(&svs.stats.deltas, deltas);
+        __sync_fetch_and_add(&svs.stats.deltaskips, deltaskips);
+    }
 }
 
 /*
@@ -422,44 +495,111 @@ void SV_WritePlayersToClient(client_t * client, edict_t * clent,
 }
 
 
+/*
+=============================================================================
+
+ENTITY SNAPSHOT
+
+The entity_state_t of every entity that could be sent is built once per
+SV_SendClientMessages, in edict order, and the per client builders only
+test the PVS and copy states out of it.  sv_snapshot 0 goes back to
+reading the edicts for every client.
+
+=============================================================================
+*/
+
+typedef struct {
+    edict_t *ent;
+    qboolean nail;              // goes out in the svc_nails update
+    entity_state_t state;
+} snapent_t;
+
+cvar_t sv_snapshot = { "sv_snapshot", "1" };
+
+static snapent_t sv_snap[MAX_EDICTS];
+static int sv_numsnap;
+
 /*
 =============
-SV_WriteEntitiesToClient
+SV_BuildSnapshot
 
-Encodes the current state of the world as
-a svc_packetentities messages and possibly
-a svc_nails message and
-svc_playerinfo messages
+Called after the physics, before any client message is built
 =============
 */
-void SV_WriteEntitiesToClient(client_t * client, sizebuf_t * msg)
+void SV_BuildSnapshot(void)
 {
-    int e, i;
-    byte *pvs;
-    vec3_t org;
+    int e;
     edict_t *ent;
-    packet_entities_t *pack;
-    edict_t *clent;
-    client_frame_t *frame;
+    snapent_t *snap;
     entity_state_t *state;
 
-    // this is the frame we are creating
-    frame =
-        &client->frames[client->netchan.incoming_sequence & UPDATE_MASK];
+    sv_numsnap = 0;
 
-    // find the client's PVS
-    clent = client->edict;
-    VectorAdd(clent->v.origin, clent->v.view_ofs, org);
-    pvs = SV_FatPVS(org);
+    for (e = MAX_CLIENTS + 1, ent = EDICT_NUM(e); e < sv.num_edicts;
+         e++, ent = NEXT_EDICT(ent)) {
+        // ignore ents without visible models
+        if (!ent->v.modelindex || !*PR_GetString(ent->v.model))
+            continue;
 
-    // send over the players in the PVS
-    SV_WritePlayersToClient(client, clent, pvs, msg);
+        snap = &sv_snap[sv_numsnap++];
+        snap->ent = ent;
+        snap->nail = ent->v.modelindex == sv_nailmodel
+            || ent->v.modelindex == sv_supernailmodel;
 
-    // put other visible entities into either a packet_entities or a nails message
-    pack = &frame->entities;
-    pack->num_entities = 0;
+        state = &snap->state;
+        state->number = e;
+        state->flags = 0;
+        VectorCopy(ent->v.origin, state->origin);
+        VectorCopy(ent->v.angles, state->angles);
+        state->modelindex = ent->v.modelindex;
+        state->frame = ent->v.frame;
+        state->colormap = ent->v.colormap;
+        state->skinnum = ent->v.skin;
+        state->effects = ent->v.effects;
+    }
+}
 
-    numnails = 0;
+static qboolean SV_EntityInPVS(edict_t * ent, byte * pvs)
+{
+    int i;
+
+    for (i = 0; i < ent->num_leafs; i++)
+        if (pvs[ent->leafnums[i] >> 3] & (1 << (ent->leafnums[i] & 7)))
+            return true;
+
+    return false;
+}
+
+// the packet entities and nails for pvs, out of the snapshot
+static void SV_AddSnapshotEntities(byte * pvs, packet_entities_t * pack)
+{
+    snapent_t *snap;
+    int i;
+
+    for (i = 0, snap = sv_snap; i < sv_numsnap; i++, snap++) {
+        if (!SV_EntityInPVS(snap->ent, pvs))
+            continue;           // not visible
+
+        if (snap->nail) {
+            if (numnails < MAX_NAILS)
+                nails[numnails++] = snap->ent;
+            continue;           // added to the special update list
+        }
+
+        // add to the packetentities
+        if (pack->num_entities == MAX_PACKET_ENTITIES)
+            continue;           // all full
+
+        pack->entities[pack->num_entities++] = snap->state;
+    }
+}
+
+// the same, straight from the edicts
+static void SV_AddEdictEntities(byte * pvs, packet_entities_t * pack)
+{
+    int e;
+    edict_t *ent;
+    entity_state_t *state;
 
     for (e = MAX_CLIENTS + 1, ent = EDICT_NUM(e); e < sv.num_edicts;
          e++, ent = NEXT_EDICT(ent)) {
@@ -468,11 +608,7 @@ void SV_WriteEntitiesToClient(client_t * client, sizebuf_t * msg)
             continue;
 
         // ignore if not touching a PV leaf
-        for (i = 0; i < ent->num_leafs; i++)
-            if (pvs[ent->leafnums[i] >> 3] & (1 << (ent->leafnums[i] & 7)))
-                break;
-
-        if (i == ent->num_leafs)
+        if (!SV_EntityInPVS(ent, pvs))
             continue;           // not visible
 
         if (SV_AddNailUpdate(ent))
@@ -495,6 +631,49 @@ void SV_WriteEntitiesToClient(client_t * client, sizebuf_t * msg)
         state->skinnum = ent->v.skin;
         state->effects = ent->v.effects;
     }
+}
+
+/*
+=============
+SV_WriteEntitiesToClient
+
+Encodes the current state of the world as
+a svc_packetentities messages and possibly
+a svc_nails message and
+svc_playerinfo messages
+=============
+*/
+void SV_WriteEntitiesToClient(client_t * client, sizebuf_t * msg)
+{
+    byte *pvs;
+    vec3_t org;
+    packet_entities_t *pack;
+    edict_t *clent;
+    client_frame_t *frame;
+
+    // this is the frame we are creating
+    frame =
+        &client->frames[client->netchan.incoming_sequence & UPDATE_MASK];
+
+    // find the client's PVS
+    clent = client->edict;
+    VectorAdd(clent->v.origin, clent->v.view_ofs, org);
+    pvs = SV_FatPVS(org);
+
+    // send over the players in the PVS
+    SV_WritePlayersToClient(client, clent, pvs, msg);
+
+    // put other visible entities into either a packet_entities or a nails message
+    pack = &frame->entities;
+    pack->num_entities = 0;
+    frame->netframe = sv_netframe;
+
+    numnails = 0;
+
+    if (sv_snapshot.value)
+        SV_AddSnapshotEntities(pvs, pack);
+    else
+        SV_AddEdictEntities(pvs, pack);
 
     // encode the packet entities as a delta from the
     // last packetentities acknowledged by the client
@@ -504,3 +683,125 @@ void SV_WriteEntitiesToClient(client_t * client, sizebuf_t * msg)
     // now add the specialized nail update
     SV_EmitNailUpdate(msg);
 }
+
+/*
+=============
+SV_SnapBench_f
+
+snapbench [clients] [frames]
+
+Builds the entity part of a full update for clients viewpoints spread over
+the spawn points and other entities of the map, once reading the edicts for
+every client and once from the snapshot, and compares time, memory touched
+and the bytes written.
+=============
+*/
+#define MAX_BENCHVIEWS  MAX_CLIENTS
+
+void SV_SnapBench_f(void)
+{
+    static packet_entities_t pack;
+    static client_t benchclient;        // never deltas
+    byte buf[MAX_DATAGRAM * 2];
+    vec3_t views[MAX_BENCHVIEWS];
+    sizebuf_t msg;
+    edict_t *ent;
+    double start, time[2];
+    int numviews, clients, frames;
+    int mode, f, c, e, i;
+    int states[2], scanned[2], bytes[2];
+    unsigned hash[2];
+    qboolean spawn;
+
+    if (sv.state != ss_active) {
+        Con_Printf("snapbench: no map running\n");
+        return;
+    }
+
+    clients = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : MAX_CLIENTS;
+    frames = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 100;
+    if (clients < 1)
+        clients = 1;
+    if (frames < 1)
+        frames = 1;
+
+    // spawn points first, then anything with a model
+    numviews = 0;
+    for (i = 0; i < 2; i++) {
+        for (e = 1; e < sv.num_edicts && numviews < MAX_BENCHVIEWS; e++) {
+            ent = EDICT_NUM(e);
+            if (ent->free)
+                continue;
+            spawn = !strncmp(PR_GetString(ent->v.classname), "info_player",
+                             11);
+            if (i == 0 ? !spawn : spawn || !ent->v.modelindex)
+                continue;
+            VectorAdd(ent->v.origin, ent->v.view_ofs, views[numviews]);
+            numviews++;
+        }
+    }
+    if (!numviews) {
+        Con_Printf("snapbench: no viewpoints\n");
+        return;
+    }
+
+    benchclient.delta_sequence = -1;
+
+    msg.data = buf;
+    msg.maxsize = sizeof(buf);
+    msg.allowoverflow = true;
+
+    for (mode = 0; mode < 2; mode++) {
+        states[mode] = scanned[mode] = bytes[mode] = 0;
+        hash[mode] = 0;
+
+        start = Sys_DoubleTime();
+        for (f = 0; f < frames; f++) {
+            if (mode) {
+                SV_BuildSnapshot();
+                scanned[mode] += sv.num_edicts;
+            }
+
+            for (c = 0; c < clients; c++) {
+                numnails = 0;
+                pack.num_entities = 0;
+
+                if (mode) {
+                    SV_AddSnapshotEntities(SV_FatPVS(views[c % numviews]),
+                                           &pack);
+                    scanned[mode] += sv_numsnap;
+                } else {
+                    SV_AddEdictEntities(SV_FatPVS(views[c % numviews]),
+                                        &pack);
+                    scanned[mode] += sv.num_edicts;
+                }
+                states[mode] += pack.num_entities;
+
+                msg.cursize = 0;
+                msg.overflowed = false;
+                SV_EmitPacketEntities(&benchclient, &pack, &msg);
+                SV_EmitNailUpdate(&msg);
+
+                bytes[mode] += msg.cursize;
+                for (i = 0; i < msg.cursize; i++)
+                    hash[mode] = hash[mode] * 31 + buf[i];
+            }
+        }
+        time[mode] = Sys_DoubleTime() - start;
+    }
+
+    Con_Printf("%i clients over %i viewpoints, %i frames, %i edicts, "
+               "%i in snapshot\n", clients, numviews, frames, sv.num_edicts,
+               sv_numsnap);
+    Con_Printf("           ms/frame  ents read/frame  state KB/frame  "
+               "bytes/frame\n");
+    for (mode = 0; mode < 2; mode++)
+        Con_Printf("%-9s %9.3f %16i %15.1f %12i\n",
+                   mode ? "snapshot" : "edicts", time[mode] * 1000 / frames,
+                   scanned[mode] / frames,
+                   (float) (states[mode] + (mode ? sv_numsnap * frames : 0))
+                   * sizeof(entity_state_t) / frames / 1024,
+                   bytes[mode] / frames);
+    Con_Printf("output %s\n", hash[0] == hash[1]
+               && bytes[0] == bytes[1] ? "identical" : "DIFFERS");
+}
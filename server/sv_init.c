@@ -281,11 +281,17 @@ void SV_SpawnServer(char *server)
 
     sv.state = ss_dead;
 
+#ifdef WITH_LUA
+    // the Lua state is kept, let go of the old level's edicts
+    PR_ClearLevel();
+#endif
+
     Mod_ClearAll();
     Hunk_FreeToLowMark(host_hunklevel);
 
     // wipe the entire per-level structure
     memset(&sv, 0, sizeof(sv));
+    SV_ClearThinks();
 
     sv.datagram.maxsize = sizeof(sv.datagram_buf);
     sv.datagram.data = sv.datagram_buf;
@@ -362,6 +368,7 @@ void SV_SpawnServer(char *server)
     ent->v.modelindex = 1;      // world model
     ent->v.solid = SOLID_BSP;
     ent->v.movetype = MOVETYPE_PUSH;
+    SV_ScheduleThink(ent);
 
     pr_global_struct->mapname = PR_SetString(sv.name);
     // serverflags are for cross level information (sigils)
@@ -35,6 +35,9 @@ client_t *host_client;          // current client
 
 cvar_t sv_mintic = { "sv_mintic", "0.03" };     // bound the size of the
 cvar_t sv_maxtic = { "sv_maxtic", "0.1" };      // physics time tic 
+#ifdef WITH_LUA
+cvar_t sv_gcbudget = { "sv_gcbudget", "1" };    // ms of Lua GC per frame
+#endif
 
 cvar_t developer = { "developer", "0" };        // show extra messages
 
@@ -331,15 +334,14 @@ Responds with all the info that qplug or qspy can see
 This message can be up to around 5k with worst case string lengths.
 ================
 */
-void SVC_Status(void)
+static void SV_StatusReply(redirect_t rd)
 {
     int i;
     client_t *cl;
     int ping;
     int top, bottom;
 
-    Cmd_TokenizeString("status");
-    SV_BeginRedirect(RD_PACKET);
+    SV_BeginRedirect(rd);
     Con_Printf("%s\n", svs.info);
     for (i = 0; i < MAX_CLIENTS; i++) {
         cl = &svs.clients[i];
@@ -361,6 +363,12 @@ void SVC_Status(void)
     SV_EndRedirect();
 }
 
+void SVC_Status(void)
+{
+    Cmd_TokenizeString("status");
+    SV_StatusReply(RD_PACKET);
+}
+
 /*
 ===================
 SV_CheckLog
@@ -659,6 +667,7 @@ void SVC_DirectConnect(void)
     Netchan_Setup(&newcl->netchan, adr, qport);
 
     newcl->state = cs_connected;
+    SV_HashClient(newcl);
 
     newcl->datagram.allowoverflow = true;
     newcl->datagram.data = newcl->datagram_buf;
@@ -1016,8 +1025,178 @@ qboolean SV_FilterPacket(void)
     return !filterban.value;
 }
 
+/*
+=================
+SV_PublishStatus
+
+Refreshes the status reply the network thread answers queries with.  It
+can't check the ip filters, so it gets no reply while they could match.
+=================
+*/
+static void SV_PublishStatus(void)
+{
+    if (numipfilters || !filterban.value) {
+        NET_SetStatus(0, NULL);
+        return;
+    }
+
+    SV_StatusReply(RD_STATUS);
+}
+
 //============================================================================
 
+/*
+=============================================================================
+
+CLIENT ADDRESS HASH
+
+Sequenced packets are matched to their client by the base address and the
+qport, never the port, which address translating routers may change.
+Every slot that is not cs_free is hashed on the same key, so a port fix-up
+leaves the table alone.
+
+=============================================================================
+*/
+
+#define	CLIENTHASH_SIZE	64      // power of two
+
+static client_t *sv_clienthash[CLIENTHASH_SIZE];
+
+static int SV_ClientHashKey(netadr_t adr, int qport)
+{
+    unsigned h;
+
+    h = (adr.ip[0] << 24) | (adr.ip[1] << 16) | (adr.ip[2] << 8) | adr.ip[3];
+    h = (h ^ (h >> 16)) * 0x45d9f3b + qport;
+
+    return (h ^ (h >> 16)) & (CLIENTHASH_SIZE - 1);
+}
+
+void SV_HashClient(client_t * cl)
+{
+    int h;
+
+    h = SV_ClientHashKey(cl->netchan.remote_address, cl->netchan.qport);
+    cl->hashnext = sv_clienthash[h];
+    sv_clienthash[h] = cl;
+}
+
+void SV_UnhashClient(client_t * cl)
+{
+    client_t **p;
+    int h;
+
+    h = SV_ClientHashKey(cl->netchan.remote_address, cl->netchan.qport);
+    for (p = &sv_clienthash[h]; *p; p = &(*p)->hashnext)
+        if (*p == cl) {
+            *p = cl->hashnext;
+            break;
+        }
+    cl->hashnext = NULL;
+}
+
+/*
+=================
+SV_ClientForAddress
+
+The client a sequenced packet from adr with qport belongs to, or NULL.
+A reconnect leaves a zombie with the same key, the lowest slot wins like
+it did when all slots were scanned.
+=================
+*/
+client_t *SV_ClientForAddress(netadr_t adr, int qport)
+{
+    client_t *cl, *best;
+
+    best = NULL;
+    for (cl = sv_clienthash[SV_ClientHashKey(adr, qport)]; cl;
+         cl = cl->hashnext) {
+        if (cl->netchan.qport != qport
+            || !NET_CompareBaseAdr(adr, cl->netchan.remote_address))
+            continue;
+        if (!best || cl < best)
+            best = cl;
+    }
+
+    return best;
+}
+
+// follows a client whose router picked a new port
+static void SV_FixupClientPort(client_t * cl, netadr_t adr)
+{
+    if (cl->netchan.remote_address.port != adr.port) {
+        Con_DPrintf("SV_ReadPackets: fixing up a translated port\n");
+        cl->netchan.remote_address.port = adr.port;
+    }
+}
+
+/*
+=================
+SV_ClientHash_f
+
+clienthash [test]
+=================
+*/
+void SV_ClientHash_f(void)
+{
+    static client_t saved;      // too big for the stack
+    client_t *cl;
+    netadr_t adr, nat;
+    int i, used, longest, n;
+    qboolean ok;
+
+    if (Cmd_Argc() < 2 || strcmp(Cmd_Argv(1), "test")) {
+        used = longest = 0;
+        for (i = 0; i < CLIENTHASH_SIZE; i++) {
+            for (n = 0, cl = sv_clienthash[i]; cl; cl = cl->hashnext)
+                n++;
+            if (n)
+                used++;
+            if (n > longest)
+                longest = n;
+        }
+        Con_Printf("%i of %i buckets used, longest chain %i\n", used,
+                   CLIENTHASH_SIZE, longest);
+        return;
+    }
+
+    // borrow a free slot for a client behind a translating router
+    for (i = 0, cl = svs.clients; i < MAX_CLIENTS; i++, cl++)
+        if (cl->state == cs_free)
+            break;
+    if (i == MAX_CLIENTS) {
+        Con_Printf("clienthash: no free slot to test with\n");
+        return;
+    }
+    saved = *cl;
+
+    NET_StringToAdr("10.1.2.3:27001", &adr);
+    Netchan_Setup(&cl->netchan, adr, 4321);
+    cl->state = cs_connected;
+    SV_HashClient(cl);
+
+    // the router moves the client to another port
+    NET_StringToAdr("10.1.2.3:40000", &nat);
+
+    ok = SV_ClientForAddress(nat, 4321) == cl;
+    if (ok)
+        SV_FixupClientPort(cl, nat);
+    ok = ok && NET_CompareAdr(cl->netchan.remote_address, nat);
+    ok = ok && SV_ClientForAddress(nat, 4321) == cl;
+    ok = ok && SV_ClientForAddress(adr, 4321) == cl;
+
+    // other qports and hosts behind the same address are someone else
+    ok = ok && SV_ClientForAddress(nat, 4322) != cl;
+    NET_StringToAdr("10.1.2.4:40000", &nat);
+    ok = ok && SV_ClientForAddress(nat, 4321) != cl;
+
+    SV_UnhashClient(cl);
+    ok = ok && SV_ClientForAddress(adr, 4321) != cl;
+    *cl = saved;
+
+    Con_Printf("clienthash: port fix-up %s\n", ok ? "passed" : "FAILED");
+}
+
 /*
 =================
 SV_ReadPackets
@@ -1025,7 +1204,6 @@ SV_ReadPackets
 */
 void SV_ReadPackets(void)
 {
-    int i;
     client_t *cl;
     int qport;
 
@@ -1047,34 +1225,28 @@ void SV_ReadPackets(void)
         qport = MSG_ReadShort() & 0xffff;
 
         // check for packets from connected clients
-        for (i = 0, cl = svs.clients; i < MAX_CLIENTS; i++, cl++) {
-            if (cl->state == cs_free)
-                continue;
-            if (!NET_CompareBaseAdr(net_from, cl->netchan.remote_address))
-                continue;
-            if (cl->netchan.qport != qport)
-                continue;
-            if (cl->netchan.remote_address.port != net_from.port) {
-                Con_DPrintf
-                    ("SV_ReadPackets: fixing up a translated port\n");
-                cl->netchan.remote_address.port = net_from.port;
-            }
+        cl = SV_ClientForAddress(net_from, qport);
+        if (cl) {
+            SV_FixupClientPort(cl, net_from);
             if (Netchan_Process(&cl->netchan)) {        // this is a valid, sequenced packet, so process it
                 svs.stats.packets++;
                 cl->send_message = true;        // reply at end of frame
                 if (cl->state != cs_zombie)
                     SV_ExecuteClientMessage(cl);
             }
-            break;
-        }
-
-        if (i != MAX_CLIENTS)
             continue;
+        }
 
         // packet is not from a known client
         //      Con_Printf ("%s:sequenced packet without connection\n"
         // ,NET_AdrToString(net_from));
     }
+
+    SV_RunMoves();
+
+    // server browsers are answered by the network thread if there is one
+    if (NET_StatusWanted())
+        SV_PublishStatus();
 }
 
 /*
@@ -1106,11 +1278,13 @@ void SV_CheckTimeouts(void)
             if (cl->netchan.last_received < droptime) {
                 SV_BroadcastPrintf(PRINT_HIGH, "%s timed out\n", cl->name);
                 SV_DropClient(cl);
+                SV_UnhashClient(cl);
                 cl->state = cs_free;    // don't bother with zombie state
             }
         }
         if (cl->state == cs_zombie &&
             realtime - cl->connection_started > zombietime.value) {
+            SV_UnhashClient(cl);
             cl->state = cs_free;        // can now be reused
         }
     }
@@ -1170,6 +1344,47 @@ void SV_CheckVars(void)
                             MAX_SERVERINFO_STRING);
 }
 
+static int SV_CompareFrameTimes(const void *a, const void *b)
+{
+    double d = *(double *)a - *(double *)b;
+
+    return d < 0 ? -1 : d > 0;
+}
+
+static double sv_frameend;     // for the idle time between frames
+
+/*
+==================
+SV_PacketFrame
+
+Reads and answers the packets that are waiting without running physics.
+The tick driven main loop calls this whenever the socket or the console
+has something between two SV_Frame calls.
+==================
+*/
+void SV_PacketFrame(float time)
+{
+    double start;
+
+    start = Sys_DoubleTime();
+    svs.stats.idle += start - sv_frameend;
+
+    if (!sv.paused) {
+        realtime += time;
+        sv.time += time;
+    }
+
+    SV_ReadPackets();
+
+    SV_GetConsoleCommands();
+    Cbuf_Execute();
+
+    SV_SendClientMessages();
+
+    sv_frameend = Sys_DoubleTime();
+    svs.stats.active += sv_frameend - start;
+}
+
 /*
 ==================
 SV_Frame
@@ -1178,10 +1393,10 @@ SV_Frame
 */
 void SV_Frame(float time)
 {
-    static double start, end;
+    double start, end;
 
     start = Sys_DoubleTime();
-    svs.stats.idle += start - end;
+    svs.stats.idle += start - sv_frameend;
 
 // keep the random time dependent
     rand();
@@ -1215,19 +1430,47 @@ void SV_Frame(float time)
 // send messages back to the clients that had packets read this frame
     SV_SendClientMessages();
 
+#ifdef WITH_LUA
+// collect Lua garbage while nothing is waiting on us
+    PR_StepGC(sv_gcbudget.value / 1000);
+#endif
+
 // send a heartbeat to the master if needed
     Master_Heartbeat();
 
 // collect timing statistics
-    end = Sys_DoubleTime();
+    end = sv_frameend = Sys_DoubleTime();
     svs.stats.active += end - start;
+    svs.stats.frametimes[svs.stats.count] = end - start;
     if (++svs.stats.count == STATFRAMES) {
+        qsort(svs.stats.frametimes, STATFRAMES, sizeof(double),
+              SV_CompareFrameTimes);
+        svs.stats.latched_p99 = svs.stats.frametimes[STATFRAMES * 99 / 100];
         svs.stats.latched_active = svs.stats.active;
         svs.stats.latched_idle = svs.stats.idle;
+        svs.stats.latched_gc = svs.stats.gc;
         svs.stats.latched_packets = svs.stats.packets;
+        svs.stats.latched_vec3allocs = svs.stats.vec3allocs;
+        svs.stats.latched_progcalls = svs.stats.progcalls;
+        svs.stats.latched_physents = svs.stats.physents;
+        svs.stats.latched_luaallocs = svs.stats.luaallocs;
+        svs.stats.latched_luabytes = svs.stats.luabytes;
+        svs.stats.latched_deltas = svs.stats.deltas;
+        svs.stats.latched_deltaskips = svs.stats.deltaskips;
+        svs.stats.latched_syscalls = svs.stats.syscalls;
+        SV_EntProfileLatch();
         svs.stats.active = 0;
         svs.stats.idle = 0;
+        svs.stats.gc = 0;
         svs.stats.packets = 0;
+        svs.stats.vec3allocs = 0;
+        svs.stats.progcalls = 0;
+        svs.stats.physents = 0;
+        svs.stats.luaallocs = 0;
+        svs.stats.luabytes = 0;
+        svs.stats.deltas = 0;
+        svs.stats.deltaskips = 0;
+        svs.stats.syscalls = 0;
         svs.stats.count = 0;
     }
 }
@@ -1250,6 +1493,7 @@ void SV_InitLocal(void)
     extern cvar_t sv_wateraccelerate;
     extern cvar_t sv_friction;
     extern cvar_t sv_waterfriction;
+    extern cvar_t sv_thinkqueue;
 
     SV_InitOperatorCommands();
     SV_UserInit();
@@ -1260,6 +1504,9 @@ void SV_InitLocal(void)
 
     Cvar_RegisterVariable(&sv_mintic);
     Cvar_RegisterVariable(&sv_maxtic);
+#ifdef WITH_LUA
+    Cvar_RegisterVariable(&sv_gcbudget);
+#endif
 
     Cvar_RegisterVariable(&fraglimit);
     Cvar_RegisterVariable(&timelimit);
@@ -1287,6 +1534,14 @@ void SV_InitLocal(void)
     Cvar_RegisterVariable(&sv_wateraccelerate);
     Cvar_RegisterVariable(&sv_friction);
     Cvar_RegisterVariable(&sv_waterfriction);
+    Cvar_RegisterVariable(&sv_thinkqueue);
+    Cvar_RegisterVariable(&sv_entprofile);
+    Cvar_RegisterVariable(&sv_netdirty);
+    Cvar_RegisterVariable(&sv_snapshot);
+    Cvar_RegisterVariable(&sv_areatree);
+    Cvar_RegisterVariable(&sv_hullnodes);
+    Cvar_RegisterVariable(&sv_threads);
+    Cvar_RegisterVariable(&net_batch);
 
     Cvar_RegisterVariable(&sv_aim);
 
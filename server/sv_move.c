@@ -142,6 +142,7 @@ qboolean SV_movestep(edict_t * ent, vec3_t move, qboolean relink)
                     return false;       // swim monster left water
 
                 VectorCopy(trace.endpos, ent->v.origin);
+                SV_MarkNetDirty(ent, ND_ORIGIN);
                 if (relink)
                     SV_LinkEdict(ent, true);
                 return true;
@@ -173,6 +174,7 @@ qboolean SV_movestep(edict_t * ent, vec3_t move, qboolean relink)
         // if monster had the ground pulled out, go ahead and fall
         if ((int) ent->v.flags & FL_PARTIALGROUND) {
             VectorAdd(ent->v.origin, move, ent->v.origin);
+            SV_MarkNetDirty(ent, ND_ORIGIN);
             if (relink)
                 SV_LinkEdict(ent, true);
             ent->v.flags = (int) ent->v.flags & ~FL_ONGROUND;
@@ -184,6 +186,7 @@ qboolean SV_movestep(edict_t * ent, vec3_t move, qboolean relink)
     }
 // check point traces down for dangling corners
     VectorCopy(trace.endpos, ent->v.origin);
+    SV_MarkNetDirty(ent, ND_ORIGIN);
 
     if (!SV_CheckBottom(ent)) {
         if ((int) ent->v.flags & FL_PARTIALGROUND) {    // entity had floor mostly pulled out from underneath it
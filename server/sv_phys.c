@@ -103,6 +103,7 @@ void SV_CheckVelocity(edict_t * ent)
             Con_Printf("Got a NaN origin on %s\n",
                        PR_GetString(ent->v.classname));
             ent->v.origin[i] = 0;
+            SV_MarkNetDirty(ent, ND_ORIGIN);
         }
         if (ent->v.velocity[i] > sv_maxvelocity.value)
             ent->v.velocity[i] = sv_maxvelocity.value;
@@ -140,7 +141,7 @@ qboolean SV_RunThink(edict_t * ent)
         pr_global_struct->time = thinktime;
         pr_global_struct->self = EDICT_TO_PROG(ent);
         pr_global_struct->other = EDICT_TO_PROG(sv.edicts);
-        PR_ExecuteProgram(ent->v.think);
+        SV_EntCall(ent, ent->v.think, EP_THINK);
 
         if (ent->free)
             return false;
@@ -167,13 +168,13 @@ void SV_Impact(edict_t * e1, edict_t * e2)
     if (e1->v.touch && e1->v.solid != SOLID_NOT) {
         pr_global_struct->self = EDICT_TO_PROG(e1);
         pr_global_struct->other = EDICT_TO_PROG(e2);
-        PR_ExecuteProgram(e1->v.touch);
+        SV_EntCall(e1, e1->v.touch, EP_TOUCH);
     }
 
     if (e2->v.touch && e2->v.solid != SOLID_NOT) {
         pr_global_struct->self = EDICT_TO_PROG(e2);
         pr_global_struct->other = EDICT_TO_PROG(e1);
-        PR_ExecuteProgram(e2->v.touch);
+        SV_EntCall(e2, e2->v.touch, EP_TOUCH);
     }
 
     pr_global_struct->self = old_self;
@@ -267,6 +268,7 @@ int SV_FlyMove(edict_t * ent, float time, trace_t * steptrace)
 
         if (trace.fraction > 0) {       // actually covered some distance
             VectorCopy(trace.endpos, ent->v.origin);
+            SV_MarkNetDirty(ent, ND_ORIGIN);
             VectorCopy(ent->v.velocity, original_velocity);
             numplanes = 0;
         }
@@ -396,6 +398,8 @@ trace_t SV_PushEntity(edict_t * ent, vec3_t push)
             SV_Move(ent->v.origin, ent->v.mins, ent->v.maxs, end,
                     MOVE_NORMAL, ent);
 
+    if (!VectorCompare(trace.endpos, ent->v.origin))
+        SV_MarkNetDirty(ent, ND_ORIGIN);
     VectorCopy(trace.endpos, ent->v.origin);
     SV_LinkEdict(ent, true);
 
@@ -432,6 +436,7 @@ qboolean SV_Push(edict_t * pusher, vec3_t move)
 // move the pusher to it's final position
 
     VectorAdd(pusher->v.origin, move, pusher->v.origin);
+    SV_MarkNetDirty(pusher, ND_ORIGIN);
     SV_LinkEdict(pusher, false);
 
 // see if any solid entities are inside the final position
@@ -473,6 +478,7 @@ qboolean SV_Push(edict_t * pusher, vec3_t move)
 
         // try moving the contacted entity 
         VectorAdd(check->v.origin, move, check->v.origin);
+        SV_MarkNetDirty(check, ND_ORIGIN);
         block = SV_TestEntityPosition(check);
         if (!block) {           // pushed ok
             SV_LinkEdict(check, false);
@@ -505,11 +511,12 @@ qboolean SV_Push(edict_t * pusher, vec3_t move)
         if (pusher->v.blocked) {
             pr_global_struct->self = EDICT_TO_PROG(pusher);
             pr_global_struct->other = EDICT_TO_PROG(check);
-            PR_ExecuteProgram(pusher->v.blocked);
+            SV_EntCall(pusher, pusher->v.blocked, EP_BLOCKED);
         }
         // move back any entities we already moved
         for (i = 0; i < num_moved; i++) {
             VectorCopy(moved_from[i], moved_edict[i]->v.origin);
+            SV_MarkNetDirty(moved_edict[i], ND_ORIGIN);
             SV_LinkEdict(moved_edict[i], false);
         }
         return false;
@@ -577,7 +584,7 @@ void SV_Physics_Pusher(edict_t * ent)
         pr_global_struct->time = sv.time;
         pr_global_struct->self = EDICT_TO_PROG(ent);
         pr_global_struct->other = EDICT_TO_PROG(sv.edicts);
-        PR_ExecuteProgram(ent->v.think);
+        SV_EntCall(ent, ent->v.think, EP_THINK);
         if (ent->free)
             return;
         VectorSubtract(ent->v.origin, oldorg, move);
@@ -586,6 +593,7 @@ void SV_Physics_Pusher(edict_t * ent)
         if (l > 1.0 / 64) {
 //      Con_Printf ("**** snap: %f\n", Length (l));
             VectorCopy(oldorg, ent->v.origin);
+            SV_MarkNetDirty(ent, ND_ORIGIN);
             SV_Push(ent, move);
         }
 
@@ -624,6 +632,7 @@ void SV_Physics_Noclip(edict_t * ent)
              ent->v.angles);
     VectorMA(ent->v.origin, host_frametime, ent->v.velocity,
              ent->v.origin);
+    SV_MarkNetDirty(ent, ND_ORIGIN | ND_ANGLES);
 
     SV_LinkEdict(ent, false);
 }
@@ -700,8 +709,11 @@ void SV_Physics_Toss(edict_t * ent)
         SV_AddGravity(ent, 1.0);
 
 // move angles
-    VectorMA(ent->v.angles, host_frametime, ent->v.avelocity,
-             ent->v.angles);
+    if (!VectorCompare(ent->v.avelocity, vec3_origin)) {
+        VectorMA(ent->v.angles, host_frametime, ent->v.avelocity,
+                 ent->v.angles);
+        SV_MarkNetDirty(ent, ND_ANGLES);
+    }
 
 // move origin
     VectorScale(ent->v.velocity, host_frametime, move);
@@ -846,6 +858,189 @@ void SV_RunNewmis(void)
     SV_RunEntity(ent);
 }
 
+/*
+==============================================================================
+
+THINK SCHEDULING
+
+MOVETYPE_NONE entities (triggers, lights, info_ and func_ helpers) only ever
+think, so rather than visiting every one of them each frame they wait in a
+heap ordered by nextthink and are only run when due.  Everything else is
+flagged in sv_runbits and runs every frame as before.  Entities are still
+visited in edict order so the progs see the same sequence of calls.
+
+The progs notify us through SV_ScheduleThink whenever movetype or nextthink
+is set.  Heap entries are not removed when an entity changes its mind, a
+popped entry is simply ignored when it no longer matches the entity.
+
+==============================================================================
+*/
+
+typedef struct {
+    float time;
+    int num;
+} thinkslot_t;
+
+#define	MAX_THINKS	(MAX_EDICTS * 2)
+
+cvar_t sv_thinkqueue = { "sv_thinkqueue", "1" };
+
+static thinkslot_t sv_thinks[MAX_THINKS];
+static int sv_numthinks;
+
+static unsigned sv_runbits[(MAX_EDICTS + 31) / 32];     // run every frame
+static unsigned sv_duebits[(MAX_EDICTS + 31) / 32];     // think this frame
+
+static void SV_PushThink(float time, int num)
+{
+    int i, parent;
+
+    i = sv_numthinks++;
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (sv_thinks[parent].time <= time)
+            break;
+        sv_thinks[i] = sv_thinks[parent];
+        i = parent;
+    }
+    sv_thinks[i].time = time;
+    sv_thinks[i].num = num;
+}
+
+/*
+================
+SV_RebuildThinks
+
+Drops all stale heap entries
+================
+*/
+static void SV_RebuildThinks(void)
+{
+    int i;
+    edict_t *ent;
+
+    sv_numthinks = 0;
+    for (i = 0; i < sv.num_edicts; i++) {
+        ent = EDICT_NUM(i);
+        if (!ent->free && ent->v.movetype == MOVETYPE_NONE
+            && ent->v.nextthink > 0)
+            SV_PushThink(ent->v.nextthink, i);
+    }
+}
+
+/*
+================
+SV_ClearThinks
+
+Called when a new level is started
+================
+*/
+void SV_ClearThinks(void)
+{
+    sv_numthinks = 0;
+    memset(sv_runbits, 0, sizeof(sv_runbits));
+    memset(sv_duebits, 0, sizeof(sv_duebits));
+}
+
+/*
+================
+SV_ScheduleThink
+
+Called whenever the movetype or nextthink of an entity changes
+================
+*/
+void SV_ScheduleThink(edict_t * ent)
+{
+    int num;
+    unsigned bit;
+
+    num = NUM_FOR_EDICT(ent);
+    bit = 1u << (num & 31);
+
+    if (ent->v.movetype != MOVETYPE_NONE) {
+        sv_runbits[num >> 5] |= bit;
+        return;
+    }
+    sv_runbits[num >> 5] &= ~bit;
+
+    if (ent->v.nextthink <= 0)
+        return;
+
+    // due within the frame being run, SV_Physics may still reach it
+    if (ent->v.nextthink <= sv.time + host_frametime)
+        sv_duebits[num >> 5] |= bit;
+
+    if (sv_numthinks == MAX_THINKS)
+        SV_RebuildThinks();
+    if (sv_numthinks < MAX_THINKS)
+        SV_PushThink(ent->v.nextthink, num);
+}
+
+#ifdef WITH_LUA
+static void SV_PopThink(void)
+{
+    int i, child;
+    thinkslot_t last;
+
+    last = sv_thinks[--sv_numthinks];
+    i = 0;
+    while ((child = i * 2 + 1) < sv_numthinks) {
+        if (child + 1 < sv_numthinks
+            && sv_thinks[child + 1].time < sv_thinks[child].time)
+            child++;
+        if (last.time <= sv_thinks[child].time)
+            break;
+        sv_thinks[i] = sv_thinks[child];
+        i = child;
+    }
+    sv_thinks[i] = last;
+}
+
+/*
+================
+SV_RunScheduled
+
+Runs the entities that move and the ones with a due think, in edict order
+================
+*/
+static void SV_RunScheduled(void)
+{
+    int i, num;
+    unsigned bits;
+    edict_t *ent;
+
+    while (sv_numthinks && sv_thinks[0].time <= sv.time + host_frametime) {
+        num = sv_thinks[0].num;
+        ent = EDICT_NUM(num);
+        if (!ent->free && ent->v.nextthink == sv_thinks[0].time)
+            sv_duebits[num >> 5] |= 1u << (num & 31);
+        SV_PopThink();
+    }
+
+    for (i = 0; i < sv.num_edicts; i++) {
+        bits = sv_runbits[i >> 5] | sv_duebits[i >> 5];
+        if (!bits) {
+            i |= 31;            // skip the rest of the word
+            continue;
+        }
+        if (!(bits & (1u << (i & 31))))
+            continue;
+        sv_duebits[i >> 5] &= ~(1u << (i & 31));
+
+        ent = EDICT_NUM(i);
+        if (ent->free)
+            continue;
+
+        if (i > 0 && i <= MAX_CLIENTS)
+            continue;           // clients are run directly from packets
+
+        svs.stats.physents++;
+        SV_RunEntity(ent);
+        SV_RunNewmis();
+    }
+}
+#endif
+
 /*
 ================
 SV_Physics
@@ -866,10 +1061,21 @@ void SV_Physics(void)
         host_frametime = sv_maxtic.value;
     old_time = realtime;
 
+    // the pmove entities are rebuilt once everything has moved
+    SV_InvalidatePmoveEnts();
+
     pr_global_struct->frametime = host_frametime;
 
     SV_ProgStartFrame();
 
+#ifdef WITH_LUA
+    // a forced retouch has to relink everything anyway
+    if (sv_thinkqueue.value && !pr_global_struct->force_retouch) {
+        SV_RunScheduled();
+        return;
+    }
+#endif
+
 //
 // treat each object in turn
 // even the world gets a chance to think
@@ -885,6 +1091,7 @@ void SV_Physics(void)
         if (i > 0 && i <= MAX_CLIENTS)
             continue;           // clients are run directly from packets
 
+        svs.stats.physents++;
         SV_RunEntity(ent);
         SV_RunNewmis();
     }
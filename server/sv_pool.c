@@ -0,0 +1,176 @@
+// sv_pool.c -- worker threads for the server frame
+
+/*
+   SV_RunPool hands out the indexes 0..count-1 of a job to sv_threads
+   worker threads and the calling thread, and returns once all of them are
+   done.  Jobs must only read shared state or write to state of their own,
+   see the THREADLOCAL globals.  Nothing that prints through Con_Printf or
+   runs progs may be called from a job.
+
+   with sv_threads 0, or where there are no pthreads, jobs run in order on
+   the calling thread.
+*/
+
+#include "qwsvdef.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+cvar_t sv_threads = { "sv_threads", "0" };
+
+#ifndef _WIN32
+
+static pthread_t pool_threads[MAX_POOLTHREADS];
+static int pool_numthreads;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+
+static pooljob_t pool_job;
+static int pool_count;          // indexes in the current job
+static int pool_next;           // next index to hand out
+static int pool_busy;           // indexes handed out but not finished
+static int pool_generation;     // bumped for every job
+static qboolean pool_quit;
+
+// runs indexes of the current job until none are left, with pool_lock held
+static void SV_PoolWork(int thread)
+{
+    int index;
+
+    while (pool_next < pool_count) {
+        index = pool_next++;
+        pool_busy++;
+        pthread_mutex_unlock(&pool_lock);
+
+        pool_job(index, thread);
+
+        pthread_mutex_lock(&pool_lock);
+        if (!--pool_busy && pool_next == pool_count)
+            pthread_cond_broadcast(&pool_done);
+    }
+}
+
+static void *SV_PoolThread(void *arg)
+{
+    int thread = (int) (size_t) arg;
+    int generation = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    while (1) {
+        while (!pool_quit && generation == pool_generation)
+            pthread_cond_wait(&pool_wake, &pool_lock);
+        if (pool_quit)
+            break;
+
+        generation = pool_generation;
+        SV_PoolWork(thread);
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    return NULL;
+}
+
+static void SV_StopPool(void)
+{
+    int i;
+
+    pthread_mutex_lock(&pool_lock);
+    pool_quit = true;
+    pthread_cond_broadcast(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (i = 0; i < pool_numthreads; i++)
+        pthread_join(pool_threads[i], NULL);
+
+    pool_numthreads = 0;
+    pool_quit = false;
+}
+
+static void SV_StartPool(int count)
+{
+    for (pool_numthreads = 0; pool_numthreads < count; pool_numthreads++)
+        if (pthread_create(&pool_threads[pool_numthreads], NULL,
+                           SV_PoolThread,
+                           (void *) (size_t) (pool_numthreads + 1))) {
+            Con_Printf("SV_StartPool: only got %i threads\n",
+                       pool_numthreads);
+            break;
+        }
+}
+
+/*
+=================
+SV_PoolThreads
+
+Brings the pool in line with sv_threads, returns the number of workers
+=================
+*/
+int SV_PoolThreads(void)
+{
+    int count;
+
+    count = sv_threads.value;
+    if (count < 0)
+        count = 0;
+    if (count > MAX_POOLTHREADS)
+        count = MAX_POOLTHREADS;
+
+    if (count != pool_numthreads) {
+        SV_StopPool();
+        SV_StartPool(count);
+    }
+
+    return pool_numthreads;
+}
+
+/*
+=================
+SV_RunPool
+
+Calls job(index, thread) for every index below count, thread is 0 for the
+calling thread and 1..MAX_POOLTHREADS for the workers
+=================
+*/
+void SV_RunPool(pooljob_t job, int count)
+{
+    int i;
+
+    if (!SV_PoolThreads() || count < 2) {
+        for (i = 0; i < count; i++)
+            job(i, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    pool_job = job;
+    pool_count = count;
+    pool_next = 0;
+    pool_busy = 0;
+    pool_generation++;
+    pthread_cond_broadcast(&pool_wake);
+
+    SV_PoolWork(0);
+    while (pool_busy || pool_next < pool_count)
+        pthread_cond_wait(&pool_done, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+#else
+
+int SV_PoolThreads(void)
+{
+    return 0;
+}
+
+void SV_RunPool(pooljob_t job, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+        job(i, 0);
+}
+
+#endif
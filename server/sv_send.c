@@ -50,7 +50,7 @@ void SV_FlushRedirect(void)
 {
     char send[8000 + 6];
 
-    if (sv_redirected == RD_PACKET) {
+    if (sv_redirected == RD_PACKET || sv_redirected == RD_STATUS) {
         send[0] = 0xff;
         send[1] = 0xff;
         send[2] = 0xff;
@@ -58,7 +58,11 @@ void SV_FlushRedirect(void)
         send[4] = A2C_PRINT;
         memcpy(send + 5, outputbuf, strlen(outputbuf) + 1);
 
-        NET_SendPacket(strlen(send) + 1, send, net_from);
+        // RD_STATUS is kept by the network thread for server browsers
+        if (sv_redirected == RD_STATUS)
+            NET_SetStatus(strlen(send) + 1, send);
+        else
+            NET_SendPacket(strlen(send) + 1, send, net_from);
     } else if (sv_redirected == RD_CLIENT) {
         ClientReliableWrite_Begin(host_client, svc_print,
                                   strlen(outputbuf) + 3);
@@ -546,50 +550,121 @@ void SV_UpdateClientStats(client_t * client)
 
 /*
 =======================
-SV_SendClientDatagram
+SV_BuildClientDatagram
+
+The world part of a datagram, everything after the client data.  Only
+reads the world and writes to the client, so it can run on pool threads
+for several clients at once.
 =======================
 */
-qboolean SV_SendClientDatagram(client_t * client)
+static void SV_BuildClientDatagram(client_t * client, sizebuf_t * msg)
 {
-    byte buf[MAX_DATAGRAM];
-    sizebuf_t msg;
-
-    msg.data = buf;
-    msg.maxsize = sizeof(buf);
-    msg.cursize = 0;
-    msg.allowoverflow = true;
-    msg.overflowed = false;
-
-    // add the client specific data to the datagram
-    SV_WriteClientdataToMessage(client, &msg);
-
     // send over all the objects that are in the PVS
     // this will include clients, a packetentities, and
     // possibly a nails update
-    SV_WriteEntitiesToClient(client, &msg);
+    SV_WriteEntitiesToClient(client, msg);
 
     // copy the accumulated multicast datagram
-    // for this client out to the message
-    if (client->datagram.overflowed)
+    // for this client out to the message,
+    // SV_TransmitClientDatagram warns about overflows
+    if (!client->datagram.overflowed) {
+        SZ_Write(msg, client->datagram.data, client->datagram.cursize);
+        SZ_Clear(&client->datagram);
+    }
+}
+
+static void SV_TransmitClientDatagram(client_t * client, sizebuf_t * msg)
+{
+    if (client->datagram.overflowed) {
         Con_Printf("WARNING: datagram overflowed for %s\n", client->name);
-    else
-        SZ_Write(&msg, client->datagram.data, client->datagram.cursize);
-    SZ_Clear(&client->datagram);
+        SZ_Clear(&client->datagram);
+    }
 
     // send deltas over reliable stream
     if (Netchan_CanReliable(&client->netchan))
         SV_UpdateClientStats(client);
 
-    if (msg.overflowed) {
+    if (msg->overflowed) {
         Con_Printf("WARNING: msg overflowed for %s\n", client->name);
-        SZ_Clear(&msg);
+        SZ_Clear(msg);
     }
     // send the datagram
-    Netchan_Transmit(&client->netchan, msg.cursize, buf);
+    Netchan_Transmit(&client->netchan, msg->cursize, msg->data);
+}
+
+static void SV_InitDatagram(sizebuf_t * msg, byte * buf, int size)
+{
+    msg->data = buf;
+    msg->maxsize = size;
+    msg->cursize = 0;
+    msg->allowoverflow = true;
+    msg->overflowed = false;
+}
+
+/*
+=======================
+SV_SendClientDatagram
+=======================
+*/
+qboolean SV_SendClientDatagram(client_t * client)
+{
+    byte buf[MAX_DATAGRAM];
+    sizebuf_t msg;
+
+    SV_InitDatagram(&msg, buf, sizeof(buf));
+
+    // add the client specific data to the datagram
+    SV_WriteClientdataToMessage(client, &msg);
+
+    SV_BuildClientDatagram(client, &msg);
+    SV_TransmitClientDatagram(client, &msg);
 
     return true;
 }
 
+/*
+=======================
+Parallel datagrams
+
+With sv_threads set, SV_SendClientMessages only collects the clients that
+get a datagram and writes their client data, which can run progs lookups.
+The world part of all of them is then built on the pool and the datagrams
+go out in client order.
+=======================
+*/
+static client_t *sv_sendclients[MAX_CLIENTS];
+static sizebuf_t sv_sendmsgs[MAX_CLIENTS];
+static byte sv_sendbufs[MAX_CLIENTS][MAX_DATAGRAM];
+static int sv_numsend;
+
+static void SV_BuildDatagramJob(int index, int thread)
+{
+    SV_BuildClientDatagram(sv_sendclients[index], &sv_sendmsgs[index]);
+}
+
+static void SV_QueueClientDatagram(client_t * client)
+{
+    sizebuf_t *msg;
+
+    msg = &sv_sendmsgs[sv_numsend];
+    SV_InitDatagram(msg, sv_sendbufs[sv_numsend], MAX_DATAGRAM);
+    SV_WriteClientdataToMessage(client, msg);
+
+    sv_sendclients[sv_numsend++] = client;
+}
+
+static void SV_SendQueuedDatagrams(void)
+{
+    int i;
+
+    SV_RunPool(SV_BuildDatagramJob, sv_numsend);
+
+    for (i = 0; i < sv_numsend; i++)
+        SV_TransmitClientDatagram(sv_sendclients[i], &sv_sendmsgs[i]);
+
+    sv_numsend = 0;
+}
+
 /*
 =======================
 SV_UpdateToReliableMessages
@@ -679,10 +754,21 @@ void SV_SendClientMessages(void)
 {
     int i, j;
     client_t *c;
+    qboolean parallel;
+
+// everything sent from here on goes out in one batch
+    NET_BeginSend();
+
+// anything written from here on is news to the frames built below
+    sv_netframe++;
+    if (sv_snapshot.value)
+        SV_BuildSnapshot();
 
 // update frags, names, etc
     SV_UpdateToReliableMessages();
 
+    parallel = SV_PoolThreads() > 0;
+
 // build individual updates
     for (i = 0, c = svs.clients; i < MAX_CLIENTS; i++, c++) {
         if (!c->state)
@@ -745,12 +831,20 @@ void SV_SendClientMessages(void)
             continue;           // bandwidth choke
         }
 
-        if (c->state == cs_spawned)
-            SV_SendClientDatagram(c);
-        else
+        if (c->state == cs_spawned) {
+            if (parallel)
+                SV_QueueClientDatagram(c);
+            else
+                SV_SendClientDatagram(c);
+        } else
             Netchan_Transmit(&c->netchan, 0, NULL);     // just update reliable
 
     }
+
+    if (parallel)
+        SV_SendQueuedDatagrams();
+
+    NET_FlushSend();
 }
 
 #ifdef _WIN32
@@ -345,7 +345,11 @@ void SV_Spawn_f(void)
     // set up the edict
     ent = host_client->edict;
 
+#ifdef WITH_LUA
+    ED_ClearVars(ent);
+#else
     memset(&ent->v, 0, progs->entityfields * 4);
+#endif
     ent->v.colormap = NUM_FOR_EDICT(ent);
     ent->v.team = 0;            // FIXME
     ent->v.netname = PR_SetString(host_client->name);
@@ -1227,7 +1231,7 @@ AddLinksToPmove
 
 ====================
 */
-void AddLinksToPmove(areanode_t * node)
+void AddLinksToPmove(playermove_t * pm, areanode_t * node)
 {
     link_t *l, *next;
     edict_t *check;
@@ -1237,10 +1241,13 @@ void AddLinksToPmove(areanode_t * node)
 
     pl = EDICT_TO_PROG(sv_player);
 
+    sv_areastats[AQ_PMOVE].nodes++;
+
     // touch linked edicts
     for (l = node->solid_edicts.next; l != &node->solid_edicts; l = next) {
         next = l->next;
         check = EDICT_FROM_AREA(l);
+        sv_areastats[AQ_PMOVE].tests++;
 
         if (check->v.owner == pl)
             continue;           // player's own missile
@@ -1256,10 +1263,10 @@ void AddLinksToPmove(areanode_t * node)
                     break;
             if (i != 3)
                 continue;
-            if (pmove.numphysent == MAX_PHYSENTS)
+            if (pm->numphysent == MAX_PHYSENTS)
                 return;
-            pe = &pmove.physents[pmove.numphysent];
-            pmove.numphysent++;
+            pe = &pm->physents[pm->numphysent];
+            pm->numphysent++;
 
             VectorCopy(check->v.origin, pe->origin);
             pe->info = NUM_FOR_EDICT(check);
@@ -1277,10 +1284,10 @@ void AddLinksToPmove(areanode_t * node)
     if (node->axis == -1)
         return;
 
-    if (pmove_maxs[node->axis] > node->dist)
-        AddLinksToPmove(node->children[0]);
-    if (pmove_mins[node->axis] < node->dist)
-        AddLinksToPmove(node->children[1]);
+    if (AREA_FRONT(node, pmove_maxs))
+        AddLinksToPmove(pm, node->children[0]);
+    if (AREA_BACK(node, pmove_mins))
+        AddLinksToPmove(pm, node->children[1]);
 }
 
 
@@ -1291,7 +1298,7 @@ AddAllEntsToPmove
 For debugging
 ================
 */
-void AddAllEntsToPmove(void)
+void AddAllEntsToPmove(playermove_t * pm)
 {
     int e;
     edict_t *check;
@@ -1318,10 +1325,10 @@ void AddAllEntsToPmove(void)
                     break;
             if (i != 3)
                 continue;
-            pe = &pmove.physents[pmove.numphysent];
+            pe = &pm->physents[pm->numphysent];
 
             VectorCopy(check->v.origin, pe->origin);
-            pmove.physents[pmove.numphysent].info = e;
+            pm->physents[pm->numphysent].info = e;
             if (check->v.solid == SOLID_BSP)
                 pe->model = sv.models[(int) (check->v.modelindex)];
             else {
@@ -1330,12 +1337,330 @@ void AddAllEntsToPmove(void)
                 VectorCopy(check->v.maxs, pe->maxs);
             }
 
-            if (++pmove.numphysent == MAX_PHYSENTS)
+            if (++pm->numphysent == MAX_PHYSENTS)
                 break;
         }
     }
 }
 
+/*
+===============================================================================
+
+PMOVE ENTITIES
+
+The link boxes of the solid edicts are kept in flat arrays, one per axis
+and bound, so AddEntsToPmove can turn most of them away without touching
+an edict.  The arrays are rebuilt in edict order from the solid_edicts
+lists the first time they are needed after physics and kept current from
+then on by SV_LinkEdict, so moves see every player moved before them as
+the area tree would.  Origin, model, owner and solid are still read from
+the edicts that pass, the progs can change those without a relink.
+
+Off by default, on the test maps it was no faster than the area tree.
+
+===============================================================================
+*/
+
+cvar_t sv_pmoveents = { "sv_pmoveents", "0" };
+
+static struct {
+    float absmin[3][MAX_EDICTS];
+    float absmax[3][MAX_EDICTS];
+    short num[MAX_EDICTS];
+    int count;
+    qboolean valid;
+} pm_ents;
+
+static short pm_slot[MAX_EDICTS];      // 1 + index into pm_ents, 0 if none
+
+static qboolean SV_PmoveSolid(edict_t * ent)
+{
+    return ent->v.solid == SOLID_BSP || ent->v.solid == SOLID_BBOX
+        || ent->v.solid == SOLID_SLIDEBOX;
+}
+
+static void SV_SetPmoveEnt(int i, edict_t * ent)
+{
+    int j;
+
+    for (j = 0; j < 3; j++) {
+        pm_ents.absmin[j][i] = ent->v.absmin[j];
+        pm_ents.absmax[j][i] = ent->v.absmax[j];
+    }
+}
+
+static void SV_BuildPmoveEnts(void)
+{
+    areanode_t *node;
+    edict_t *check;
+    link_t *l;
+    int e;
+
+    memset(pm_slot, 0, sizeof(pm_slot));
+    pm_ents.count = 0;
+
+    // the lists SV_LinkEdict chose, v.solid may have changed since
+    for (e = 0, node = sv_areanodes; e < sv_numareanodes; e++, node++)
+        for (l = node->solid_edicts.next; l != &node->solid_edicts;
+             l = l->next)
+            pm_slot[NUM_FOR_EDICT(EDICT_FROM_AREA(l))] = 1;
+
+    check = NEXT_EDICT(sv.edicts);
+    for (e = 1; e < sv.num_edicts; e++, check = NEXT_EDICT(check)) {
+        if (!pm_slot[e])
+            continue;
+        SV_SetPmoveEnt(pm_ents.count, check);
+        pm_ents.num[pm_ents.count] = e;
+        pm_slot[e] = ++pm_ents.count;
+    }
+
+    pm_ents.valid = true;
+}
+
+/*
+================
+SV_InvalidatePmoveEnts
+
+Called before physics moves everything, and when the world is cleared
+================
+*/
+void SV_InvalidatePmoveEnts(void)
+{
+    pm_ents.valid = false;
+}
+
+/*
+================
+SV_LinkPmoveEnt
+
+Called by SV_LinkEdict once ent is in the area tree
+================
+*/
+void SV_LinkPmoveEnt(edict_t * ent)
+{
+    int e;
+
+    // SV_UnlinkEdict took it out first, on a trigger list it stays out
+    if (!pm_ents.valid || ent->v.solid == SOLID_TRIGGER)
+        return;
+
+    e = NUM_FOR_EDICT(ent);
+    if (pm_slot[e])
+        SV_SetPmoveEnt(pm_slot[e] - 1, ent);
+    else
+        pm_ents.valid = false;  // new to the arrays, rebuild them
+}
+
+void SV_UnlinkPmoveEnt(edict_t * ent)
+{
+    int e;
+
+    if (!pm_ents.valid)
+        return;
+
+    // a box that is never below anything
+    e = NUM_FOR_EDICT(ent);
+    if (pm_slot[e])
+        pm_ents.absmin[0][pm_slot[e] - 1] = 999999;
+}
+
+/*
+================
+AddEntsToPmove
+
+Same as AddLinksToPmove, out of the pmove entity arrays
+================
+*/
+void AddEntsToPmove(playermove_t * pm)
+{
+    static int hit[MAX_EDICTS];
+    edict_t *check;
+    physent_t *pe;
+    vec3_t mins, maxs;
+    int i, j, hits, pl;
+
+    if (!pm_ents.valid)
+        SV_BuildPmoveEnts();
+
+    sv_areastats[AQ_PMOVE].tests += pm_ents.count;
+
+    pl = EDICT_TO_PROG(sv_player);
+    VectorCopy(pmove_mins, mins);
+    VectorCopy(pmove_maxs, maxs);
+
+    // a branch free pass over the bounds, the rest only sees the hits
+    for (i = hits = 0; i < pm_ents.count; i++) {
+        hit[hits] = i;
+        hits += (pm_ents.absmin[0][i] <= maxs[0])
+            & (pm_ents.absmin[1][i] <= maxs[1])
+            & (pm_ents.absmin[2][i] <= maxs[2])
+            & (pm_ents.absmax[0][i] >= mins[0])
+            & (pm_ents.absmax[1][i] >= mins[1])
+            & (pm_ents.absmax[2][i] >= mins[2]);
+    }
+
+    for (j = 0; j < hits; j++) {
+        i = hit[j];
+        check = EDICT_NUM(pm_ents.num[i]);
+        if (check->v.owner == pl)
+            continue;           // player's own missile
+        if (check == sv_player || !SV_PmoveSolid(check))
+            continue;
+
+        if (pm->numphysent == MAX_PHYSENTS)
+            return;
+        pe = &pm->physents[pm->numphysent];
+        pm->numphysent++;
+
+        VectorCopy(check->v.origin, pe->origin);
+        pe->info = pm_ents.num[i];
+        if (check->v.solid == SOLID_BSP)
+            pe->model = sv.models[(int) (check->v.modelindex)];
+        else {
+            pe->model = NULL;
+            VectorCopy(check->v.mins, pe->mins);
+            VectorCopy(check->v.maxs, pe->maxs);
+        }
+    }
+}
+
+static int SV_ComparePhysents(const void *a, const void *b)
+{
+    return ((physent_t *) a)->info - ((physent_t *) b)->info;
+}
+
+/*
+================
+SV_PmoveCenter
+
+Sets the pmove box around the next solid edict after *e
+================
+*/
+static void SV_PmoveCenter(int *e)
+{
+    edict_t *ent;
+    int i;
+
+    for (i = 0; i < sv.num_edicts; i++) {
+        *e = (*e + 1) % sv.num_edicts;
+        ent = EDICT_NUM(*e);
+        if (!ent->free && ent->area.prev && SV_PmoveSolid(ent))
+            break;
+    }
+    ent = EDICT_NUM(*e);
+
+    for (i = 0; i < 3; i++) {
+        pmove_mins[i] = ent->v.origin[i] - 256;
+        pmove_maxs[i] = ent->v.origin[i] + 256;
+    }
+}
+
+/*
+================
+SV_PmoveBench_f
+
+pmovebench [moves]
+
+Gathers the physents for moves centered on each solid edict in turn, by
+walking the area tree and by scanning the pmove entity arrays.  Checks
+first that both find the same ones around every solid edict, with a
+trigger made solid without a relink sitting on the first of them.
+================
+*/
+void SV_PmoveBench_f(void)
+{
+    static physent_t found[MAX_PHYSENTS];
+    areastats_t saved;
+    edict_t *oldplayer, *stale;
+    double start, time[2];
+    int moves, mode, m, e, i, numfound, physents[2], wrong;
+
+    if (sv.state != ss_active) {
+        Con_Printf("pmovebench: no map running\n");
+        return;
+    }
+
+    moves = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : 10000;
+    if (moves < 1)
+        moves = 1;
+
+    // the first client slot owns nothing the map spawns
+    oldplayer = sv_player;
+    sv_player = EDICT_NUM(1);
+    saved = sv_areastats[AQ_PMOVE];
+
+    // only on the trigger list, so neither may return it
+    e = 0;
+    SV_PmoveCenter(&e);
+    stale = ED_Alloc();
+    VectorCopy(EDICT_NUM(e)->v.origin, stale->v.origin);
+    for (i = 0; i < 3; i++) {
+        stale->v.mins[i] = -16;
+        stale->v.maxs[i] = 16;
+    }
+    stale->v.solid = SOLID_TRIGGER;
+    SV_LinkEdict(stale, false);
+    stale->v.solid = SOLID_BBOX;
+
+    SV_BuildPmoveEnts();
+
+    wrong = 0;
+    for (m = e = 0; m < pm_ents.count; m++) {
+        SV_PmoveCenter(&e);
+
+        pmove.numphysent = 1;
+        AddLinksToPmove(&pmove, sv_areanodes);
+        qsort(pmove.physents + 1, pmove.numphysent - 1, sizeof(physent_t),
+              SV_ComparePhysents);
+        memcpy(found, pmove.physents, sizeof(found));
+        numfound = pmove.numphysent;
+
+        pmove.numphysent = 1;
+        AddEntsToPmove(&pmove);
+        qsort(pmove.physents + 1, pmove.numphysent - 1, sizeof(physent_t),
+              SV_ComparePhysents);
+
+        if (pmove.numphysent != numfound)
+            wrong++;
+        else
+            for (i = 1; i < numfound; i++)
+                if (pmove.physents[i].info != found[i].info) {
+                    wrong++;
+                    break;
+                }
+    }
+
+    for (mode = 0; mode < 2; mode++) {
+        physents[mode] = 0;
+        start = Sys_DoubleTime();
+
+        for (m = e = 0; m < moves; m++) {
+            SV_PmoveCenter(&e);
+            pmove.numphysent = 1;
+            if (mode)
+                AddEntsToPmove(&pmove);
+            else
+                AddLinksToPmove(&pmove, sv_areanodes);
+            physents[mode] += pmove.numphysent - 1;
+        }
+
+        time[mode] = Sys_DoubleTime() - start;
+    }
+
+    ED_Free(stale);
+    sv_player = oldplayer;
+    sv_areastats[AQ_PMOVE] = saved;
+
+    Con_Printf("%i moves, %i edicts, %i in the pmove arrays\n", moves,
+               sv.num_edicts, pm_ents.count);
+    Con_Printf("          us/move  physents/move\n");
+    for (mode = 0; mode < 2; mode++)
+        Con_Printf("%-8s %8.3f %14.2f\n", mode ? "arrays" : "areatree",
+                   time[mode] * 1e6 / moves, (float) physents[mode] / moves);
+    Con_Printf("%i of %i solid edicts got different physents\n", wrong,
+               pm_ents.count);
+}
+
 /*
 ===========
 SV_PreRunCmd
@@ -1351,27 +1676,14 @@ void SV_PreRunCmd(void)
 
 /*
 ===========
-SV_RunCmd
+SV_StartMove
+
+Runs the player's prethink for ucmd and fills in pm for the move
 ===========
 */
-void SV_RunCmd(usercmd_t * ucmd)
+static void SV_StartMove(playermove_t * pm, usercmd_t * ucmd)
 {
-    edict_t *ent;
-    int i, n;
-    int oldmsec;
-
-    cmd = *ucmd;
-
-    // chop up very long commands
-    if (cmd.msec > 50) {
-        oldmsec = ucmd->msec;
-        cmd.msec = oldmsec / 2;
-        SV_RunCmd(&cmd);
-        cmd.msec = oldmsec / 2;
-        cmd.impulse = 0;
-        SV_RunCmd(&cmd);
-        return;
-    }
+    int i;
 
     if (!sv_player->v.fixangle)
         VectorCopy(ucmd->angles, sv_player->v.v_angle);
@@ -1402,97 +1714,145 @@ void SV_RunCmd(usercmd_t * ucmd)
 
         pr_global_struct->time = sv.time;
         pr_global_struct->self = EDICT_TO_PROG(sv_player);
-        PR_ExecuteProgram(pr_global_struct->PlayerPreThink);
+        SV_EntCall(sv_player, pr_global_struct->PlayerPreThink, EP_THINK);
 
         SV_RunThink(sv_player);
     }
 
     for (i = 0; i < 3; i++)
-        pmove.origin[i] =
+        pm->origin[i] =
             sv_player->v.origin[i] + (sv_player->v.mins[i] -
                                       player_mins[i]);
-    VectorCopy(sv_player->v.velocity, pmove.velocity);
-    VectorCopy(sv_player->v.v_angle, pmove.angles);
+    VectorCopy(sv_player->v.velocity, pm->velocity);
+    VectorCopy(sv_player->v.v_angle, pm->angles);
 
-    pmove.spectator = host_client->spectator;
-    pmove.waterjumptime = sv_player->v.teleport_time;
-    pmove.numphysent = 1;
-    pmove.physents[0].model = sv.worldmodel;
-    pmove.cmd = *ucmd;
-    pmove.dead = sv_player->v.health <= 0;
-    pmove.oldbuttons = host_client->oldbuttons;
+    pm->spectator = host_client->spectator;
+    pm->waterjumptime = sv_player->v.teleport_time;
+    pm->numphysent = 1;
+    pm->physents[0].model = sv.worldmodel;
+    pm->cmd = *ucmd;
+    pm->dead = sv_player->v.health <= 0;
+    pm->oldbuttons = host_client->oldbuttons;
 
-    movevars.entgravity = host_client->entgravity;
-    movevars.maxspeed = host_client->maxspeed;
+    pm->movevars = movevars;
+    pm->movevars.entgravity = host_client->entgravity;
+    pm->movevars.maxspeed = host_client->maxspeed;
 
     for (i = 0; i < 3; i++) {
-        pmove_mins[i] = pmove.origin[i] - 256;
-        pmove_maxs[i] = pmove.origin[i] + 256;
+        pmove_mins[i] = pm->origin[i] - 256;
+        pmove_maxs[i] = pm->origin[i] + 256;
     }
 #if 1
-    AddLinksToPmove(sv_areanodes);
+    sv_areastats[AQ_PMOVE].queries++;
+    if (sv_pmoveents.value)
+        AddEntsToPmove(pm);
+    else
+        AddLinksToPmove(pm, sv_areanodes);
 #else
-    AddAllEntsToPmove();
+    AddAllEntsToPmove(pm);
 #endif
+}
 
-#if 0
-    {
-        int before, after;
-
-        before = PM_TestPlayerPosition(pmove.origin);
-        PlayerMove();
-        after = PM_TestPlayerPosition(pmove.origin);
+/*
+===========
+SV_FinishMove
 
-        if (sv_player->v.health > 0 && before && !after)
-            Con_Printf("player %s got stuck in playermove!!!!\n",
-                       host_client->name);
-    }
-#else
-    PlayerMove();
-#endif
+Copies the result of the move back to the player and runs the touches,
+touched holds the edicts touched since the last SV_PreRunCmd
+===========
+*/
+static void SV_FinishMove(playermove_t * pm, byte * touched)
+{
+    edict_t *ent;
+    int i, n;
 
-    host_client->oldbuttons = pmove.oldbuttons;
-    sv_player->v.teleport_time = pmove.waterjumptime;
-    sv_player->v.waterlevel = waterlevel;
-    sv_player->v.watertype = watertype;
-    if (onground != -1) {
+    host_client->oldbuttons = pm->oldbuttons;
+    sv_player->v.teleport_time = pm->waterjumptime;
+    sv_player->v.waterlevel = pm->waterlevel;
+    sv_player->v.watertype = pm->watertype;
+    if (pm->onground != -1) {
         sv_player->v.flags = (int) sv_player->v.flags | FL_ONGROUND;
         sv_player->v.groundentity =
-            EDICT_TO_PROG(EDICT_NUM(pmove.physents[onground].info));
+            EDICT_TO_PROG(EDICT_NUM(pm->physents[pm->onground].info));
     } else
         sv_player->v.flags = (int) sv_player->v.flags & ~FL_ONGROUND;
     for (i = 0; i < 3; i++)
         sv_player->v.origin[i] =
-            pmove.origin[i] - (sv_player->v.mins[i] - player_mins[i]);
+            pm->origin[i] - (sv_player->v.mins[i] - player_mins[i]);
 
 #if 0
     // truncate velocity the same way the net protocol will
     for (i = 0; i < 3; i++)
-        sv_player->v.velocity[i] = (int) pmove.velocity[i];
+        sv_player->v.velocity[i] = (int) pm->velocity[i];
 #else
-    VectorCopy(pmove.velocity, sv_player->v.velocity);
+    VectorCopy(pm->velocity, sv_player->v.velocity);
 #endif
 
-    VectorCopy(pmove.angles, sv_player->v.v_angle);
+    VectorCopy(pm->angles, sv_player->v.v_angle);
 
     if (!host_client->spectator) {
+        pr_global_struct->frametime = host_frametime;
+
         // link into place and touch triggers
         SV_LinkEdict(sv_player, true);
 
         // touch other objects
-        for (i = 0; i < pmove.numtouch; i++) {
-            n = pmove.physents[pmove.touchindex[i]].info;
+        for (i = 0; i < pm->numtouch; i++) {
+            n = pm->physents[pm->touchindex[i]].info;
             ent = EDICT_NUM(n);
-            if (!ent->v.touch || (playertouch[n / 8] & (1 << (n % 8))))
+            if (!ent->v.touch || (touched[n / 8] & (1 << (n % 8))))
                 continue;
             pr_global_struct->self = EDICT_TO_PROG(ent);
             pr_global_struct->other = EDICT_TO_PROG(sv_player);
-            PR_ExecuteProgram(ent->v.touch);
-            playertouch[n / 8] |= 1 << (n % 8);
+            SV_EntCall(ent, ent->v.touch, EP_TOUCH);
+            touched[n / 8] |= 1 << (n % 8);
         }
     }
 }
 
+/*
+===========
+SV_RunCmd
+===========
+*/
+void SV_RunCmd(usercmd_t * ucmd)
+{
+    int oldmsec;
+
+    cmd = *ucmd;
+
+    // chop up very long commands
+    if (cmd.msec > 50) {
+        oldmsec = ucmd->msec;
+        cmd.msec = oldmsec / 2;
+        SV_RunCmd(&cmd);
+        cmd.msec = oldmsec / 2;
+        cmd.impulse = 0;
+        SV_RunCmd(&cmd);
+        return;
+    }
+
+    SV_StartMove(&pmove, ucmd);
+
+#if 0
+    {
+        int before, after;
+
+        before = PM_TestPlayerPosition(&pmove, pmove.origin);
+        PlayerMove(&pmove);
+        after = PM_TestPlayerPosition(&pmove, pmove.origin);
+
+        if (sv_player->v.health > 0 && before && !after)
+            Con_Printf("player %s got stuck in playermove!!!!\n",
+                       host_client->name);
+    }
+#else
+    PlayerMove(&pmove);
+#endif
+
+    SV_FinishMove(&pmove, playertouch);
+}
+
 /*
 ===========
 SV_PostRunCmd
@@ -1506,7 +1866,7 @@ void SV_PostRunCmd(void)
     if (!host_client->spectator) {
         pr_global_struct->time = sv.time;
         pr_global_struct->self = EDICT_TO_PROG(sv_player);
-        PR_ExecuteProgram(pr_global_struct->PlayerPostThink);
+        SV_EntCall(sv_player, pr_global_struct->PlayerPostThink, EP_THINK);
         SV_RunNewmis();
     } else if (SpectatorThink) {
         pr_global_struct->time = sv.time;
@@ -1516,6 +1876,170 @@ void SV_PostRunCmd(void)
 }
 
 
+/*
+===============================================================================
+
+PARALLEL MOVES
+
+With sv_parallelmove set the moves in client packets are queued, and run
+by SV_RunMoves once all waiting packets are read.  The queues are worked
+through in rounds of one command per client: the prethinks and physent
+gathers run in client order, then the PlayerMove calls run on the worker
+pool, then the results are copied back and the touches run in client
+order.  A player moves against the others as they were at the start of
+the round, not as their moves in the same round left them.
+
+===============================================================================
+*/
+
+cvar_t sv_parallelmove = { "sv_parallelmove", "0" };
+
+#define	MAX_QUEUEDCMDS	(20 * 8)        // 20 commands, chopped in 8 at most
+
+typedef struct {
+    int numcmds;
+    usercmd_t cmds[MAX_QUEUEDCMDS];
+    byte touched[(MAX_EDICTS + 7) / 8];
+    qboolean moving;            // started in the current round
+    playermove_t pm;
+} movequeue_t;
+
+static movequeue_t sv_movequeues[MAX_CLIENTS];
+static qboolean sv_movesqueued;
+
+static playermove_t *sv_movejobs[MAX_CLIENTS];
+
+static void SV_PlayerMoveJob(int index, int thread)
+{
+    PlayerMove(sv_movejobs[index]);
+}
+
+// chops up very long commands the same way SV_RunCmd does
+static void SV_QueueCmd(movequeue_t * q, usercmd_t * ucmd)
+{
+    usercmd_t half;
+
+    if (ucmd->msec > 50) {
+        half = *ucmd;
+        half.msec = ucmd->msec / 2;
+        SV_QueueCmd(q, &half);
+        half.impulse = 0;
+        SV_QueueCmd(q, &half);
+        return;
+    }
+
+    q->cmds[q->numcmds++] = *ucmd;
+}
+
+/*
+===========
+SV_QueueMove
+
+Queues the commands SV_ExecuteClientMessage would run for a clc_move
+===========
+*/
+static void SV_QueueMove(client_t * cl, usercmd_t * oldest,
+                         usercmd_t * oldcmd, usercmd_t * newcmd)
+{
+    movequeue_t *q;
+
+    q = &sv_movequeues[cl - svs.clients];
+
+    // every packet gets its own prethink to postthink run
+    if (q->numcmds)
+        SV_RunMoves();
+
+    memset(q->touched, 0, sizeof(q->touched));
+
+    if (net_drop < 20) {
+        while (net_drop > 2) {
+            SV_QueueCmd(q, &cl->lastcmd);
+            net_drop--;
+        }
+        if (net_drop > 1)
+            SV_QueueCmd(q, oldest);
+        if (net_drop > 0)
+            SV_QueueCmd(q, oldcmd);
+    }
+    SV_QueueCmd(q, newcmd);
+
+    sv_movesqueued = true;
+}
+
+/*
+===========
+SV_RunMoves
+
+Runs the queued moves, called once the packets are read and before
+anything else a client sent is acted on
+===========
+*/
+void SV_RunMoves(void)
+{
+    client_t *cl, *oldclient;
+    edict_t *oldplayer;
+    movequeue_t *q;
+    int i, round, rounds, count;
+
+    if (!sv_movesqueued)
+        return;
+    sv_movesqueued = false;
+
+    oldclient = host_client;
+    oldplayer = sv_player;
+
+    rounds = 0;
+    for (i = 0; i < MAX_CLIENTS; i++)
+        if (sv_movequeues[i].numcmds > rounds)
+            rounds = sv_movequeues[i].numcmds;
+
+    for (round = 0; round < rounds; round++) {
+        count = 0;
+        for (i = 0, cl = svs.clients; i < MAX_CLIENTS; i++, cl++) {
+            q = &sv_movequeues[i];
+            q->moving = round < q->numcmds && cl->state == cs_spawned;
+            if (!q->moving)
+                continue;
+
+            host_client = cl;
+            sv_player = cl->edict;
+            SV_StartMove(&q->pm, &q->cmds[round]);
+            sv_movejobs[count++] = &q->pm;
+        }
+
+        SV_RunPool(SV_PlayerMoveJob, count);
+
+        for (i = 0, cl = svs.clients; i < MAX_CLIENTS; i++, cl++) {
+            q = &sv_movequeues[i];
+            if (!q->moving)
+                continue;
+
+            host_client = cl;
+            sv_player = cl->edict;
+            host_frametime = q->cmds[round].msec * 0.001;
+            if (host_frametime > 0.1)
+                host_frametime = 0.1;
+            SV_FinishMove(&q->pm, q->touched);
+        }
+    }
+
+    for (i = 0, cl = svs.clients; i < MAX_CLIENTS; i++, cl++) {
+        q = &sv_movequeues[i];
+        if (!q->numcmds)
+            continue;
+        q->numcmds = 0;
+
+        if (cl->state != cs_spawned)
+            continue;
+        host_client = cl;
+        sv_player = cl->edict;
+        SV_PostRunCmd();
+    }
+
+    host_client = oldclient;
+    sv_player = oldplayer;
+}
+
 /*
 ===================
 SV_ExecuteClientMessage
@@ -1619,7 +2143,9 @@ void SV_ExecuteClientMessage(client_t * cl)
                 return;
             }
 
-            if (!sv.paused) {
+            if (!sv.paused && sv_parallelmove.value) {
+                SV_QueueMove(cl, &oldest, &oldcmd, &newcmd);
+            } else if (!sv.paused) {
                 SV_PreRunCmd();
 
                 if (net_drop < 20) {
@@ -1644,6 +2170,7 @@ void SV_ExecuteClientMessage(client_t * cl)
 
         case clc_stringcmd:
             s = MSG_ReadString();
+            SV_RunMoves();
             SV_ExecuteUserCommand(s);
             break;
 
@@ -1653,6 +2180,7 @@ void SV_ExecuteClientMessage(client_t * cl)
             o[2] = MSG_ReadCoord();
             // only allowed by spectators
             if (host_client->spectator) {
+                SV_RunMoves();
                 VectorCopy(o, sv_player->v.origin);
                 SV_LinkEdict(sv_player, false);
             }
@@ -1677,4 +2205,6 @@ void SV_UserInit(void)
     Cvar_RegisterVariable(&cl_rollangle);
     Cvar_RegisterVariable(&sv_spectalk);
     Cvar_RegisterVariable(&sv_mapcheck);
+    Cvar_RegisterVariable(&sv_pmoveents);
+    Cvar_RegisterVariable(&sv_parallelmove);
 }
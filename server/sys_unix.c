@@ -35,8 +35,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include <time.h>
 
+#ifdef __linux__
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#define SYS_TICKLOOP
+#endif
+
 cvar_t sys_nostdout = { "sys_nostdout", "0" };
 cvar_t sys_extrasleep = { "sys_extrasleep", "0" };
+cvar_t sys_ticrate = { "sys_ticrate", "0" };    // seconds, 0 runs on packets
 
 qboolean stdin_ready;
 
@@ -206,8 +214,166 @@ void Sys_Init(void)
 {
     Cvar_RegisterVariable(&sys_nostdout);
     Cvar_RegisterVariable(&sys_extrasleep);
+    Cvar_RegisterVariable(&sys_ticrate);
+}
+
+/*
+===============================================================================
+
+				MAIN LOOP
+
+===============================================================================
+*/
+
+static qboolean benchmark;
+static clock_t clock_total;
+static double clock_next;
+static int clock_frames;
+
+/*
+=============
+Sys_RunFrame
+=============
+*/
+static void Sys_RunFrame(float time, double newtime)
+{
+    clock_t clock_start;
+
+    clock_start = clock();
+    SV_Frame(time);
+    clock_total += clock() - clock_start;
+    clock_frames++;
+
+    if (benchmark && newtime >= clock_next) {
+        Sys_Printf("%ld clocks/f (%ld clocks, %ld frames)\n", clock_total / clock_frames, clock_total, clock_frames);
+        clock_next = newtime + 2.0;
+        clock_total = clock_frames = 0;
+    }
+
+    // extrasleep is just a way to generate a fucked up connection on purpose
+    if (sys_extrasleep.value)
+        usleep(sys_extrasleep.value);
+}
+
+#ifdef SYS_TICKLOOP
+
+/*
+=============
+Sys_ArmTimer
+
+Makes the timer fire every period seconds
+=============
+*/
+static void Sys_ArmTimer(int timerfd, double period)
+{
+    struct itimerspec its;
+
+    if (period < 0.001)
+        period = 0.001;
+
+    its.it_interval.tv_sec = (time_t) period;
+    its.it_interval.tv_nsec = (long) ((period - its.it_interval.tv_sec) * 1e9);
+    its.it_value = its.it_interval;
+    timerfd_settime(timerfd, 0, &its, NULL);
+}
+
+/*
+=============
+Sys_TickLoop
+
+Runs SV_Frame every sys_ticrate seconds off a timerfd and answers packets
+and console input as they arrive with SV_PacketFrame, until sys_ticrate is
+cleared.  With nobody connected the timer slows down to once a second,
+which is all the select loop did for timeouts and heartbeats.
+
+Returns the time of the last frame for the select loop to carry on from.
+=============
+*/
+static double Sys_TickLoop(double oldtime)
+{
+    struct epoll_event ev, events[3];
+    double newtime, period, armed;
+    uint64_t expirations;
+    int epfd, timerfd, n, i;
+    qboolean tick, pollstdin;
+    client_t *cl;
+
+    epfd = epoll_create(3);
+    timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (epfd == -1 || timerfd == -1) {
+        Con_Printf("Sys_TickLoop: %s\n", strerror(errno));
+        Cvar_SetValue("sys_ticrate", 0);
+        if (epfd != -1)
+            close(epfd);
+        return oldtime;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = NET_WaitFd();
+    epoll_ctl(epfd, EPOLL_CTL_ADD, NET_WaitFd(), &ev);
+    ev.data.fd = timerfd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, timerfd, &ev);
+
+    // files and /dev/null can't be polled, select calls them always ready
+    ev.data.fd = 0;
+    pollstdin = do_stdin && !epoll_ctl(epfd, EPOLL_CTL_ADD, 0, &ev);
+
+    Con_Printf("Ticking every %g seconds\n", sys_ticrate.value);
+
+    armed = 0;
+    while (sys_ticrate.value > 0) {
+        period = 1;
+        for (i = 0, cl = svs.clients; i < MAX_CLIENTS; i++, cl++)
+            if (cl->state != cs_free) {
+                period = sys_ticrate.value;
+                break;
+            }
+        if (period != armed) {
+            Sys_ArmTimer(timerfd, period);
+            armed = period;
+        }
+
+        if (pollstdin && !do_stdin) {
+            epoll_ctl(epfd, EPOLL_CTL_DEL, 0, &ev);
+            pollstdin = false;
+        }
+
+        n = epoll_wait(epfd, events, 3, -1);
+        if (n == -1)
+            continue;
+
+        tick = false;
+        for (i = 0; i < n; i++) {
+            if (events[i].data.fd == timerfd) {
+                // missed ticks just make for a longer frame
+                read(timerfd, &expirations, sizeof(expirations));
+                tick = true;
+            } else if (events[i].data.fd == 0) {
+                stdin_ready = true;
+            }
+        }
+        if (tick && !pollstdin && do_stdin)
+            stdin_ready = true;
+
+        newtime = Sys_DoubleTime();
+        if (tick)
+            Sys_RunFrame(newtime - oldtime, newtime);
+        else
+            SV_PacketFrame(newtime - oldtime);
+        oldtime = newtime;
+    }
+
+    close(timerfd);
+    close(epfd);
+
+    Con_Printf("Running frames on packets\n");
+
+    return oldtime;
 }
 
+#endif
+
 /*
 =============
 main
@@ -218,13 +384,8 @@ int main(int argc, char *argv[])
     double time, oldtime, newtime;
     quakeparms_t parms;
     fd_set fdset;
-    extern int net_socket;
     struct timeval timeout;
     int j;
-    clock_t clock_total, clock_start, clock_end;
-    double clock_next;
-    int clock_frames;
-    qboolean benchmark;
 
     memset(&parms, 0, sizeof(parms));
 
@@ -262,6 +423,11 @@ int main(int argc, char *argv[])
     clock_next = oldtime + 2.0;
     clock_total = clock_frames = 0;
     while (1) {
+#ifdef SYS_TICKLOOP
+        if (sys_ticrate.value > 0)
+            oldtime = Sys_TickLoop(oldtime);
+#endif
+
         // select on the net socket and stdin
         // the only reason we have a timeout at all is so that if the last
         // connected client times out, the message would not otherwise
@@ -269,10 +435,10 @@ int main(int argc, char *argv[])
         FD_ZERO(&fdset);
         if (do_stdin)
             FD_SET(0, &fdset);
-        FD_SET(net_socket, &fdset);
+        FD_SET(NET_WaitFd(), &fdset);
         timeout.tv_sec = 1;
         timeout.tv_usec = 0;
-        if (select(net_socket + 1, &fdset, NULL, NULL, &timeout) == -1)
+        if (select(NET_WaitFd() + 1, &fdset, NULL, NULL, &timeout) == -1)
             continue;
         stdin_ready = FD_ISSET(0, &fdset);
 
@@ -281,22 +447,7 @@ int main(int argc, char *argv[])
         time = newtime - oldtime;
         oldtime = newtime;
 
-        clock_start = clock();
-        SV_Frame(time);
-        clock_end = clock();
-
-        clock_total += clock_end - clock_start;
-        clock_frames++;
-
-        if (benchmark && newtime >= clock_next) {
-            Sys_Printf("%ld clocks/f (%ld clocks, %ld frames)\n", clock_total / clock_frames, clock_total, clock_frames);
-            clock_next = newtime + 2.0;
-            clock_total = clock_frames = 0;
-        }
-
-        // extrasleep is just a way to generate a fucked up connection on purpose
-        if (sys_extrasleep.value)
-            usleep(sys_extrasleep.value);
+        Sys_RunFrame(time, newtime);
     }
 
     return 0;
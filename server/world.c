@@ -171,13 +171,34 @@ hull_t *SV_HullForEntity(edict_t * ent, vec3_t mins, vec3_t maxs,
 
 ENTITY AREA CHECKING
 
+sv_areatree 0 is the original tree, split four times on x or y.
+
+sv_areatree 1 sizes the tree for the map when it is loaded: deep enough
+for about AREA_LEAFEDICTS entities per leaf going by the map's entity
+lump, as long as the leaves stay AREA_MINSIZE units across.  It splits
+on z as well, and its children are loose: each reaches AREA_LOOSE units
+past the split, so an entity that straddles a split near a leaf doesn't
+have to stay in the node above.
+
 ===============================================================================
 */
 
+#define	AREA_LEAFEDICTS	4
+#define	AREA_MINSIZE	256
+#define	AREA_LOOSE		32
+
+cvar_t sv_areatree = { "sv_areatree", "0" };
 
-areanode_t sv_areanodes[AREA_NODES];
+areanode_t sv_areanodes[MAX_AREA_NODES];
 int sv_numareanodes;
 
+areastats_t sv_areastats[NUM_AREAQUERIES];
+
+static int sv_areadepth;
+static int sv_areaaxes;         // 2 splits on x and y only
+static int sv_areaminsize;
+static float sv_arealoose;
+
 /*
 ===============
 SV_CreateAreaNode
@@ -189,6 +210,7 @@ areanode_t *SV_CreateAreaNode(int depth, vec3_t mins, vec3_t maxs)
     areanode_t *anode;
     vec3_t size;
     vec3_t mins1, maxs1, mins2, maxs2;
+    int i;
 
     anode = &sv_areanodes[sv_numareanodes];
     sv_numareanodes++;
@@ -196,19 +218,20 @@ areanode_t *SV_CreateAreaNode(int depth, vec3_t mins, vec3_t maxs)
     ClearLink(&anode->trigger_edicts);
     ClearLink(&anode->solid_edicts);
 
-    if (depth == AREA_DEPTH) {
+    VectorSubtract(maxs, mins, size);
+    anode->axis = 0;
+    for (i = 1; i < sv_areaaxes; i++)
+        if (size[i] >= size[anode->axis])
+            anode->axis = i;
+
+    if (depth == sv_areadepth || size[anode->axis] < 2 * sv_areaminsize) {
         anode->axis = -1;
         anode->children[0] = anode->children[1] = NULL;
         return anode;
     }
 
-    VectorSubtract(maxs, mins, size);
-    if (size[0] > size[1])
-        anode->axis = 0;
-    else
-        anode->axis = 1;
-
     anode->dist = 0.5 * (maxs[anode->axis] + mins[anode->axis]);
+    anode->loose = sv_arealoose;
     VectorCopy(mins, mins1);
     VectorCopy(mins, mins2);
     VectorCopy(maxs, maxs1);
@@ -230,11 +253,39 @@ SV_ClearWorld
 */
 void SV_ClearWorld(void)
 {
+    char *s;
+    int count;
+
     SV_InitBoxHull();
 
+    sv_areadepth = AREA_DEPTH;
+    sv_areaaxes = 2;
+    sv_areaminsize = 0;
+    sv_arealoose = 0;
+
+    if (sv_areatree.value) {
+        // the edicts aren't spawned yet, count the ones the map has
+        count = 0;
+        for (s = sv.worldmodel->entities; s && *s; s++)
+            if (*s == '{')
+                count++;
+
+        for (sv_areadepth = 1; sv_areadepth < MAX_AREA_DEPTH
+             && (1 << sv_areadepth) * AREA_LEAFEDICTS < count;
+             sv_areadepth++);
+        if (sv_areadepth < AREA_DEPTH)
+            sv_areadepth = AREA_DEPTH;
+        sv_areaaxes = 3;
+        sv_areaminsize = AREA_MINSIZE;
+        sv_arealoose = AREA_LOOSE;
+    }
+
     memset(sv_areanodes, 0, sizeof(sv_areanodes));
     sv_numareanodes = 0;
     SV_CreateAreaNode(0, sv.worldmodel->mins, sv.worldmodel->maxs);
+
+    memset(sv_areastats, 0, sizeof(sv_areastats));
+    SV_InvalidatePmoveEnts();
 }
 
 
@@ -250,6 +301,7 @@ void SV_UnlinkEdict(edict_t * ent)
         return;                 // not linked in anywhere
     RemoveLink(&ent->area);
     ent->area.prev = ent->area.next = NULL;
+    SV_UnlinkPmoveEnt(ent);
 }
 
 
@@ -264,11 +316,14 @@ void SV_TouchLinks(edict_t * ent, areanode_t * node)
     edict_t *touch;
     int old_self, old_other;
 
+    sv_areastats[AQ_TOUCH].nodes++;
+
 // touch linked edicts
     for (l = node->trigger_edicts.next; l != &node->trigger_edicts;
          l = next) {
         next = l->next;
         touch = EDICT_FROM_AREA(l);
+        sv_areastats[AQ_TOUCH].tests++;
         if (touch == ent)
             continue;
         if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER)
@@ -287,7 +342,7 @@ void SV_TouchLinks(edict_t * ent, areanode_t * node)
         pr_global_struct->self = EDICT_TO_PROG(touch);
         pr_global_struct->other = EDICT_TO_PROG(ent);
         pr_global_struct->time = sv.time;
-        PR_ExecuteProgram(touch->v.touch);
+        SV_EntCall(touch, touch->v.touch, EP_TOUCH);
 
         pr_global_struct->self = old_self;
         pr_global_struct->other = old_other;
@@ -297,9 +352,9 @@ void SV_TouchLinks(edict_t * ent, areanode_t * node)
     if (node->axis == -1)
         return;
 
-    if (ent->v.absmax[node->axis] > node->dist)
+    if (AREA_FRONT(node, ent->v.absmax))
         SV_TouchLinks(ent, node->children[0]);
-    if (ent->v.absmin[node->axis] < node->dist)
+    if (AREA_BACK(node, ent->v.absmin))
         SV_TouchLinks(ent, node->children[1]);
 }
 
@@ -397,13 +452,15 @@ void SV_LinkEdict(edict_t * ent, qboolean touch_triggers)
         return;
 
 // find the first node that the ent's box crosses
+    sv_areastats[AQ_LINK].queries++;
     node = sv_areanodes;
     while (1) {
+        sv_areastats[AQ_LINK].nodes++;
         if (node->axis == -1)
             break;
-        if (ent->v.absmin[node->axis] > node->dist)
+        if (AREA_FRONT(node, ent->v.absmin))
             node = node->children[0];
-        else if (ent->v.absmax[node->axis] < node->dist)
+        else if (AREA_BACK(node, ent->v.absmax))
             node = node->children[1];
         else
             break;              // crosses the node
@@ -415,14 +472,135 @@ void SV_LinkEdict(edict_t * ent, qboolean touch_triggers)
         InsertLinkBefore(&ent->area, &node->trigger_edicts);
     else
         InsertLinkBefore(&ent->area, &node->solid_edicts);
+    SV_LinkPmoveEnt(ent);
 
 // if touch_triggers, touch all entities at this node and decend for more
-    if (touch_triggers)
+    if (touch_triggers) {
+        sv_areastats[AQ_TOUCH].queries++;
         SV_TouchLinks(ent, sv_areanodes);
+    }
 }
 
 
 
+/*
+====================
+SV_AreaEdicts_r
+
+====================
+*/
+static int SV_AreaEdicts_r(areanode_t * node, vec3_t mins, vec3_t maxs,
+                           edict_t ** list, int count, int maxcount)
+{
+    link_t *l, *start;
+    edict_t *check;
+    int i;
+
+    sv_areastats[AQ_AREAEDICTS].nodes++;
+
+    for (i = 0; i < 2; i++) {
+        start = i ? &node->trigger_edicts : &node->solid_edicts;
+        for (l = start->next; l != start; l = l->next) {
+            check = EDICT_FROM_AREA(l);
+            sv_areastats[AQ_AREAEDICTS].tests++;
+            if (check->v.absmin[0] > maxs[0]
+                || check->v.absmin[1] > maxs[1]
+                || check->v.absmin[2] > maxs[2]
+                || check->v.absmax[0] < mins[0]
+                || check->v.absmax[1] < mins[1]
+                || check->v.absmax[2] < mins[2])
+                continue;
+            if (count == maxcount) {
+                Con_Printf("SV_AreaEdicts: MAXCOUNT\n");
+                return count;
+            }
+            list[count++] = check;
+        }
+    }
+
+// recurse down both sides
+    if (node->axis == -1)
+        return count;
+
+    if (AREA_FRONT(node, maxs))
+        count = SV_AreaEdicts_r(node->children[0], mins, maxs, list, count,
+                                maxcount);
+    if (AREA_BACK(node, mins))
+        count = SV_AreaEdicts_r(node->children[1], mins, maxs, list, count,
+                                maxcount);
+
+    return count;
+}
+
+/*
+====================
+SV_AreaEdicts
+
+Fills list with the linked edicts whose abs box touches the given box and
+returns how many were found.  The world and SOLID_NOT entities are never
+linked, so they are never returned.
+====================
+*/
+int SV_AreaEdicts(vec3_t mins, vec3_t maxs, edict_t ** list, int maxcount)
+{
+    sv_areastats[AQ_AREAEDICTS].queries++;
+    return SV_AreaEdicts_r(sv_areanodes, mins, maxs, list, 0, maxcount);
+}
+
+/*
+====================
+SV_AreaStats_f
+
+areastats [reset]
+====================
+*/
+void SV_AreaStats_f(void)
+{
+    static char *names[NUM_AREAQUERIES] =
+        { "link", "touch", "areaedicts", "move", "pmove" };
+    areanode_t *node;
+    areastats_t *st;
+    link_t *l;
+    int i, j, count, leafs, linked, inner, most;
+
+    if (Cmd_Argc() > 1 && !strcmp(Cmd_Argv(1), "reset")) {
+        memset(sv_areastats, 0, sizeof(sv_areastats));
+        return;
+    }
+
+    leafs = linked = inner = most = 0;
+    for (i = 0, node = sv_areanodes; i < sv_numareanodes; i++, node++) {
+        count = 0;
+        for (j = 0; j < 2; j++) {
+            link_t *start = j ? &node->trigger_edicts : &node->solid_edicts;
+            for (l = start->next; l != start; l = l->next)
+                count++;
+        }
+
+        linked += count;
+        if (node->axis == -1)
+            leafs++;
+        else
+            inner += count;
+        if (count > most)
+            most = count;
+    }
+
+    Con_Printf("%s tree: %i nodes, %i leafs, depth %i, %i axes, loose %g\n",
+               sv_arealoose ? "adaptive" : "fixed", sv_numareanodes, leafs,
+               sv_areadepth, sv_areaaxes, sv_arealoose);
+    Con_Printf("%i edicts linked, %i above the leafs, at most %i in a node\n",
+               linked, inner, most);
+    Con_Printf("query         queries  nodes/q  tests/q\n");
+    for (i = 0; i < NUM_AREAQUERIES; i++) {
+        st = &sv_areastats[i];
+        Con_Printf("%-12s %8.0f %8.2f %8.2f\n", names[i], st->queries,
+                   st->queries ? st->nodes / st->queries : 0,
+                   st->queries ? st->tests / st->queries : 0);
+    }
+}
+
+
 /*
 ===============================================================================
 
@@ -476,7 +654,13 @@ SV_PointContents
 */
 int SV_PointContents(vec3_t p)
 {
-    return SV_HullPointContents(&sv.worldmodel->hulls[0], 0, p);
+    hull_t *hull;
+
+    hull = &sv.worldmodel->hulls[0];
+    if (hull->nodes)
+        return Mod_HullNodeContents(hull, hull->firstnode, p);
+
+    return SV_HullPointContents(hull, 0, p);
 }
 
 //===========================================================================
@@ -650,6 +834,44 @@ qboolean SV_RecursiveHullCheck(hull_t * hull, int num, float p1f,
 }
 
 
+/*
+==================
+SV_TraceHull
+
+Traces through the packed nodes when the hull has them
+==================
+*/
+static void SV_TraceHull(hull_t * hull, vec3_t p1, vec3_t p2,
+                         trace_t * trace)
+{
+    hulltrace_t t;
+
+    if (hull->nodes) {
+        t.allsolid = trace->allsolid;
+        t.startsolid = trace->startsolid;
+        t.inopen = trace->inopen;
+        t.inwater = trace->inwater;
+        t.fraction = trace->fraction;
+        VectorCopy(trace->endpos, t.endpos);
+        VectorCopy(trace->plane.normal, t.normal);
+        t.dist = trace->plane.dist;
+
+        if (Mod_TraceHull(hull, p1, p2, &t)) {
+            trace->allsolid = t.allsolid;
+            trace->startsolid = t.startsolid;
+            trace->inopen = t.inopen;
+            trace->inwater = t.inwater;
+            trace->fraction = t.fraction;
+            VectorCopy(t.endpos, trace->endpos);
+            VectorCopy(t.normal, trace->plane.normal);
+            trace->plane.dist = t.dist;
+            return;
+        }
+    }
+
+    SV_RecursiveHullCheck(hull, hull->firstclipnode, 0, 1, p1, p2, trace);
+}
+
 /*
 ==================
 SV_ClipMoveToEntity
@@ -679,8 +901,7 @@ trace_t SV_ClipMoveToEntity(edict_t * ent, vec3_t start, vec3_t mins,
     VectorSubtract(end, offset, end_l);
 
 // trace a line through the apropriate clipping hull
-    SV_RecursiveHullCheck(hull, hull->firstclipnode, 0, 1, start_l, end_l,
-                          &trace);
+    SV_TraceHull(hull, start_l, end_l, &trace);
 
 // fix trace up by the offset
     if (trace.fraction != 1)
@@ -693,8 +914,205 @@ trace_t SV_ClipMoveToEntity(edict_t * ent, vec3_t start, vec3_t mins,
     return trace;
 }
 
+/*
+==================
+SV_TraceBench_f
+
+tracebench [traces]
+
+Traces random segments through the world hulls, with the recursive check
+on the clipnodes and with the packed nodes, and checks that both give
+the same traces.  Then traces spreads of lines around them with SV_Move
+one at a time and with SV_MoveLines in shotgun sized batches.
+==================
+*/
+#define BENCH_SEGMENTS 1024
+#define BENCH_BATCH 16
+
+// line i of a spread around the first segment, like a shotgun blast
+static void SV_BenchSpread(vec3_t (*segments)[2], int i, vec3_t start,
+                           vec3_t end)
+{
+    int j;
+
+    VectorCopy(segments[0][0], start);
+    for (j = 0; j < 3; j++)
+        end[j] = segments[0][1][j] +
+            (segments[i][1][j] - segments[0][1][j]) * 0.0625;
+}
+
+static qboolean SV_SameTrace(trace_t * a, trace_t * b)
+{
+    return a->allsolid == b->allsolid && a->startsolid == b->startsolid
+        && a->inopen == b->inopen && a->inwater == b->inwater
+        && a->fraction == b->fraction && VectorCompare(a->endpos, b->endpos)
+        && VectorCompare(a->plane.normal, b->plane.normal)
+        && a->plane.dist == b->plane.dist && a->ent == b->ent;
+}
+
+void SV_TraceBench_f(void)
+{
+    static vec3_t segments[BENCH_SEGMENTS][2];
+    static vec3_t starts[BENCH_BATCH], ends[BENCH_BATCH];
+    static trace_t batch[BENCH_BATCH];
+    trace_t trace, packed;
+    hull_t *hull;
+    model_t *world;
+    unsigned seed;
+    double start, time[2];
+    int traces, h, mode, t, i, j, wrong;
+
+    if (sv.state != ss_active) {
+        Con_Printf("tracebench: no map running\n");
+        return;
+    }
+
+    world = sv.worldmodel;
+    if (!world->hulls[0].nodes || !world->hulls[1].nodes) {
+        Con_Printf("tracebench: the map was loaded without hull nodes\n");
+        return;
+    }
+
+    traces = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : 100000;
+    if (traces < 1)
+        traces = 1;
+
+    // the same segments every time
+    seed = 0x2545f491;
+    for (i = 0; i < BENCH_SEGMENTS; i++)
+        for (j = 0; j < 6; j++) {
+            seed = seed * 1664525 + 1013904223;
+            segments[i][j / 3][j % 3] = world->mins[j % 3] +
+                (world->maxs[j % 3] - world->mins[j % 3]) *
+                ((seed >> 8) / (float) (1 << 24));
+        }
+
+    Con_Printf("%i traces, %i nodes, %i clipnodes\n", traces,
+               world->numnodes, world->numclipnodes);
+    Con_Printf("hull  recursive ns   packed ns  wrong\n");
+
+    for (h = 0; h < 3; h++) {
+        hull = &world->hulls[h];
+
+        wrong = 0;
+        for (i = 0; i < BENCH_SEGMENTS; i++) {
+            memset(&trace, 0, sizeof(trace));
+            trace.fraction = 1;
+            trace.allsolid = true;
+            VectorCopy(segments[i][1], trace.endpos);
+            packed = trace;
+
+            SV_RecursiveHullCheck(hull, hull->firstclipnode, 0, 1,
+                                  segments[i][0], segments[i][1], &trace);
+            SV_TraceHull(hull, segments[i][0], segments[i][1], &packed);
+
+            if (!SV_SameTrace(&trace, &packed))
+                wrong++;
+        }
+
+        for (mode = 0; mode < 2; mode++) {
+            start = Sys_DoubleTime();
+
+            for (t = 0; t < traces; t++) {
+                i = t & (BENCH_SEGMENTS - 1);
+                memset(&trace, 0, sizeof(trace));
+                trace.fraction = 1;
+                trace.allsolid = true;
+                VectorCopy(segments[i][1], trace.endpos);
+
+                if (mode)
+                    SV_TraceHull(hull, segments[i][0], segments[i][1],
+                                 &trace);
+                else
+                    SV_RecursiveHullCheck(hull, hull->firstclipnode, 0, 1,
+                                          segments[i][0], segments[i][1],
+                                          &trace);
+            }
+
+            time[mode] = Sys_DoubleTime() - start;
+        }
+
+        Con_Printf("%4i %14.1f %11.1f %6i\n", h, time[0] * 1e9 / traces,
+                   time[1] * 1e9 / traces, wrong);
+    }
+
+    Con_Printf("lines    SV_Move ns  batched ns  wrong\n");
+
+    wrong = 0;
+    for (t = 0; t < BENCH_SEGMENTS; t += BENCH_BATCH) {
+        for (i = 0; i < BENCH_BATCH; i++) {
+            SV_BenchSpread(segments + t, i, starts[i], ends[i]);
+        }
+        SV_MoveLines(BENCH_BATCH, starts, ends, MOVE_NORMAL, NULL,
+                     batch);
+
+        for (i = 0; i < BENCH_BATCH; i++) {
+            trace = SV_Move(starts[i], vec3_origin, vec3_origin, ends[i],
+                            MOVE_NORMAL, NULL);
+            if (!SV_SameTrace(&trace, &batch[i]))
+                wrong++;
+        }
+    }
+
+    for (mode = 0; mode < 2; mode++) {
+        start = Sys_DoubleTime();
+
+        for (t = 0; t < traces; t += BENCH_BATCH) {
+            j = t & (BENCH_SEGMENTS - 1);
+            for (i = 0; i < BENCH_BATCH; i++) {
+                SV_BenchSpread(segments + j, i, starts[i], ends[i]);
+            }
+
+            if (mode)
+                SV_MoveLines(BENCH_BATCH, starts, ends, MOVE_NORMAL,
+                             NULL, batch);
+            else
+                for (i = 0; i < BENCH_BATCH; i++)
+                    batch[i] = SV_Move(starts[i], vec3_origin, vec3_origin,
+                                       ends[i], MOVE_NORMAL, NULL);
+        }
+
+        time[mode] = Sys_DoubleTime() - start;
+    }
+
+    Con_Printf("%4i %14.1f %11.1f %6i\n", BENCH_BATCH,
+               time[0] * 1e9 / traces, time[1] * 1e9 / traces, wrong);
+}
+
 //===========================================================================
 
+/*
+====================
+SV_ClipToEdict
+
+Does the exact clip against touch, which passed the cheap tests, and
+keeps the nearest trace in clip
+====================
+*/
+static void SV_ClipToEdict(moveclip_t * clip, edict_t * touch)
+{
+    trace_t trace;
+
+    if ((int) touch->v.flags & FL_MONSTER)
+        trace =
+            SV_ClipMoveToEntity(touch, clip->start, clip->mins2,
+                                clip->maxs2, clip->end);
+    else
+        trace =
+            SV_ClipMoveToEntity(touch, clip->start, clip->mins,
+                                clip->maxs, clip->end);
+    if (trace.allsolid || trace.startsolid
+        || trace.fraction < clip->trace.fraction) {
+        trace.ent = touch;
+        if (clip->trace.startsolid) {
+            clip->trace = trace;
+            clip->trace.startsolid = true;
+        } else
+            clip->trace = trace;
+    } else if (trace.startsolid)
+        clip->trace.startsolid = true;
+}
+
 /*
 ====================
 SV_ClipToLinks
@@ -706,12 +1124,14 @@ void SV_ClipToLinks(areanode_t * node, moveclip_t * clip)
 {
     link_t *l, *next;
     edict_t *touch;
-    trace_t trace;
+
+    sv_areastats[AQ_MOVE].nodes++;
 
 // touch linked edicts
     for (l = node->solid_edicts.next; l != &node->solid_edicts; l = next) {
         next = l->next;
         touch = EDICT_FROM_AREA(l);
+        sv_areastats[AQ_MOVE].tests++;
         if (touch->v.solid == SOLID_NOT)
             continue;
         if (touch == clip->passedict)
@@ -744,33 +1164,16 @@ void SV_ClipToLinks(areanode_t * node, moveclip_t * clip)
                 continue;       // don't clip against owner
         }
 
-        if ((int) touch->v.flags & FL_MONSTER)
-            trace =
-                SV_ClipMoveToEntity(touch, clip->start, clip->mins2,
-                                    clip->maxs2, clip->end);
-        else
-            trace =
-                SV_ClipMoveToEntity(touch, clip->start, clip->mins,
-                                    clip->maxs, clip->end);
-        if (trace.allsolid || trace.startsolid
-            || trace.fraction < clip->trace.fraction) {
-            trace.ent = touch;
-            if (clip->trace.startsolid) {
-                clip->trace = trace;
-                clip->trace.startsolid = true;
-            } else
-                clip->trace = trace;
-        } else if (trace.startsolid)
-            clip->trace.startsolid = true;
+        SV_ClipToEdict(clip, touch);
     }
 
 // recurse down both sides
     if (node->axis == -1)
         return;
 
-    if (clip->boxmaxs[node->axis] > node->dist)
+    if (AREA_FRONT(node, clip->boxmaxs))
         SV_ClipToLinks(node->children[0], clip);
-    if (clip->boxmins[node->axis] < node->dist)
+    if (AREA_BACK(node, clip->boxmins))
         SV_ClipToLinks(node->children[1], clip);
 }
 
@@ -840,11 +1243,120 @@ trace_t SV_Move(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end,
                   clip.boxmaxs);
 
 // clip to entities
+    sv_areastats[AQ_MOVE].queries++;
     SV_ClipToLinks(sv_areanodes, &clip);
 
     return clip.trace;
 }
 
+/*
+==================
+SV_MoveLines
+
+SV_Move with no size for count lines at once.  The edicts around all of
+the lines are gathered once and the tests that don't depend on the line
+are done once per edict, then each line is clipped to the world and to
+the edicts that touch its box, which ends at the nearest hit so far.
+The area nodes list the edicts in the order SV_ClipToLinks visits them,
+so the traces come out the same.
+==================
+*/
+void SV_MoveLines(int count, vec3_t * starts, vec3_t * ends, int type,
+                  edict_t * passedict, trace_t * traces)
+{
+    static edict_t *list[MAX_EDICTS];
+    moveclip_t clip;
+    vec3_t boxmins, boxmaxs;
+    edict_t *touch;
+    float fraction;
+    int i, j, e, numtouch;
+
+    if (count < 1)
+        return;
+
+    memset(&clip, 0, sizeof(moveclip_t));
+
+    clip.mins = clip.maxs = vec3_origin;
+    clip.type = type;
+    clip.passedict = passedict;
+
+    if (type == MOVE_MISSILE) {
+        for (i = 0; i < 3; i++) {
+            clip.mins2[i] = -15;
+            clip.maxs2[i] = 15;
+        }
+    }
+
+// gather the edicts around all of the lines
+    for (i = 0; i < count; i++) {
+        SV_MoveBounds(starts[i], clip.mins2, clip.maxs2, ends[i],
+                      clip.boxmins, clip.boxmaxs);
+        for (j = 0; j < 3; j++) {
+            if (!i || clip.boxmins[j] < boxmins[j])
+                boxmins[j] = clip.boxmins[j];
+            if (!i || clip.boxmaxs[j] > boxmaxs[j])
+                boxmaxs[j] = clip.boxmaxs[j];
+        }
+    }
+
+    numtouch = SV_AreaEdicts(boxmins, boxmaxs, list, MAX_EDICTS);
+
+    for (e = j = 0; e < numtouch; e++) {
+        touch = list[e];
+        if (touch->v.solid == SOLID_NOT || touch->v.solid == SOLID_TRIGGER)
+            continue;
+        if (touch == passedict)
+            continue;
+        if (type == MOVE_NOMONSTERS && touch->v.solid != SOLID_BSP)
+            continue;
+        if (passedict) {
+            if (passedict->v.size[0] && !touch->v.size[0])
+                continue;       // points never interact
+            if (PROG_TO_EDICT(touch->v.owner) == passedict)
+                continue;       // don't clip against own missiles
+            if (PROG_TO_EDICT(passedict->v.owner) == touch)
+                continue;       // don't clip against owner
+        }
+        list[j++] = touch;
+    }
+    numtouch = j;
+
+// clip each line
+    for (i = 0; i < count; i++) {
+        clip.start = starts[i];
+        clip.end = ends[i];
+        clip.trace = SV_ClipMoveToEntity(sv.edicts, starts[i], vec3_origin,
+                                         vec3_origin, ends[i]);
+
+        SV_MoveBounds(starts[i], clip.mins2, clip.maxs2, clip.trace.endpos,
+                      clip.boxmins, clip.boxmaxs);
+
+        for (e = 0; e < numtouch && !clip.trace.allsolid; e++) {
+            touch = list[e];
+            if (clip.boxmins[0] > touch->v.absmax[0]
+                || clip.boxmins[1] > touch->v.absmax[1]
+                || clip.boxmins[2] > touch->v.absmax[2]
+                || clip.boxmaxs[0] < touch->v.absmin[0]
+                || clip.boxmaxs[1] < touch->v.absmin[1]
+                || clip.boxmaxs[2] < touch->v.absmin[2])
+                continue;
+
+            fraction = clip.trace.fraction;
+            SV_ClipToEdict(&clip, touch);
+
+            // an edict can only take the trace by holding the start or by
+            // being hit before the current end, so the rest of the line
+            // needs no more exact clips
+            if (clip.trace.fraction != fraction)
+                SV_MoveBounds(starts[i], clip.mins2, clip.maxs2,
+                              clip.trace.endpos, clip.boxmins,
+                              clip.boxmaxs);
+        }
+
+        traces[i] = clip.trace;
+    }
+}
+
 //=============================================================================
 
 /*
@@ -863,8 +1375,12 @@ edict_t *SV_TestPlayerPosition(edict_t * ent, vec3_t origin)
 
 // check world first
     hull = &sv.worldmodel->hulls[1];
-    if (SV_HullPointContents(hull, hull->firstclipnode, origin) !=
-        CONTENTS_EMPTY)
+    if (hull->nodes) {
+        if (Mod_HullNodeContents(hull, hull->firstnode, origin) !=
+            CONTENTS_EMPTY)
+            return sv.edicts;
+    } else if (SV_HullPointContents(hull, hull->firstclipnode, origin) !=
+               CONTENTS_EMPTY)
         return sv.edicts;
 
 // check all entities
@@ -897,8 +1413,12 @@ edict_t *SV_TestPlayerPosition(edict_t * ent, vec3_t origin)
         VectorSubtract(origin, offset, offset);
 
         // test the point
-        if (SV_HullPointContents(hull, hull->firstclipnode, offset) !=
-            CONTENTS_EMPTY)
+        if (hull->nodes) {
+            if (Mod_HullNodeContents(hull, hull->firstnode, offset) !=
+                CONTENTS_EMPTY)
+                return check;
+        } else if (SV_HullPointContents(hull, hull->firstclipnode, offset)
+                   != CONTENTS_EMPTY)
             return check;
     }
 
@@ -24,7 +24,7 @@ typedef struct {
     float dist;
 } plane_t;
 
-typedef struct {
+typedef struct trace_s {
     qboolean allsolid;          // if true, plane is not valid
     qboolean startsolid;        // if true, the initial point was in a solid area
     qboolean inopen, inwater;
@@ -42,6 +42,7 @@ typedef struct {
 typedef struct areanode_s {
     int axis;                   // -1 = leaf node
     float dist;
+    float loose;                // the children reach this far past dist
     struct areanode_s *children[2];
     link_t trigger_edicts;
     link_t solid_edicts;
@@ -50,7 +51,39 @@ typedef struct areanode_s {
 #define	AREA_DEPTH	4
 #define	AREA_NODES	32
 
-extern areanode_t sv_areanodes[AREA_NODES];
+// sv_areatree 1 sizes the tree for the map
+#define	MAX_AREA_DEPTH	9
+#define	MAX_AREA_NODES	(2 << MAX_AREA_DEPTH)
+
+// a box fits in the front child when AREA_FRONT(node, mins) and in the
+// back child when AREA_BACK(node, maxs), a query box reaches into them
+// when AREA_FRONT(node, maxs) and AREA_BACK(node, mins)
+#define	AREA_FRONT(n,mins)	((mins)[(n)->axis] > (n)->dist - (n)->loose)
+#define	AREA_BACK(n,maxs)	((maxs)[(n)->axis] < (n)->dist + (n)->loose)
+
+extern areanode_t sv_areanodes[MAX_AREA_NODES];
+extern int sv_numareanodes;
+
+typedef enum {
+    AQ_LINK,
+    AQ_TOUCH,
+    AQ_AREAEDICTS,
+    AQ_MOVE,
+    AQ_PMOVE,
+    NUM_AREAQUERIES
+} areaquery_t;
+
+typedef struct {
+    double queries;
+    double nodes;               // areanodes visited
+    double tests;               // edicts whose box was checked
+} areastats_t;
+
+extern areastats_t sv_areastats[NUM_AREAQUERIES];
+extern cvar_t sv_areatree;
+
+void SV_AreaStats_f(void);
+void SV_TraceBench_f(void);
 
 
 void SV_ClearWorld(void);
@@ -67,6 +100,10 @@ void SV_LinkEdict(edict_t * ent, qboolean touch_triggers);
 // sets ent->v.absmin and ent->v.absmax
 // if touchtriggers, calls prog functions for the intersected triggers
 
+int SV_AreaEdicts(vec3_t mins, vec3_t maxs, edict_t ** list, int maxcount);
+// fills in a list of all linked edicts whose abs box touches the given box
+// returns the number of edicts found
+
 int SV_PointContents(vec3_t p);
 // returns the CONTENTS_* value from the world at the given point.
 // does not check any entities at all
@@ -87,5 +124,11 @@ trace_t SV_Move(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end,
 
 // passedict is explicitly excluded from clipping checks (normally NULL)
 
+#define	MAX_MOVELINES	64
+
+void SV_MoveLines(int count, vec3_t * starts, vec3_t * ends, int type,
+                  edict_t * passedict, trace_t * traces);
+// SV_Move with no size for each of count lines, filling in traces
+
 
 edict_t *SV_TestPlayerPosition(edict_t * ent, vec3_t origin);
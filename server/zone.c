@@ -34,11 +34,11 @@ typedef struct memblock_s {
     int pad;                    // pad to 64 bit boundary
 } memblock_t;
 
-typedef struct {
+struct memzone_s {
     int size;                   // total bytes malloced, including header
     memblock_t blocklist;       // start / end cap for linked list
     memblock_t *rover;
-} memzone_t;
+};
 
 void Cache_FreeLow(int new_low_hunk);
 void Cache_FreeHigh(int new_high_hunk);
@@ -89,12 +89,36 @@ void Z_ClearZone(memzone_t * zone, int size)
 }
 
 
+/*
+========================
+Z_NewZone
+
+Sets aside a zone of its own on the hunk for a subsystem
+========================
+*/
+memzone_t *Z_NewZone(int size, char *name)
+{
+    memzone_t *zone;
+
+    zone = Hunk_AllocName(size, name);
+    Z_ClearZone(zone, size);
+    zone->size = size;
+
+    return zone;
+}
+
+
 /*
 ========================
 Z_Free
 ========================
 */
 void Z_Free(void *ptr)
+{
+    Z_FreeZone(mainzone, ptr);
+}
+
+void Z_FreeZone(memzone_t * zone, void *ptr)
 {
     memblock_t *block, *other;
 
@@ -114,8 +138,8 @@ void Z_Free(void *ptr)
         other->size += block->size;
         other->next = block->next;
         other->next->prev = other;
-        if (block == mainzone->rover)
-            mainzone->rover = other;
+        if (block == zone->rover)
+            zone->rover = other;
         block = other;
     }
 
@@ -124,8 +148,8 @@ void Z_Free(void *ptr)
         block->size += other->size;
         block->next = other->next;
         block->next->prev = block;
-        if (other == mainzone->rover)
-            mainzone->rover = block;
+        if (other == zone->rover)
+            zone->rover = block;
     }
 }
 
@@ -149,6 +173,11 @@ void *Z_Malloc(int size)
 }
 
 void *Z_TagMalloc(int size, int tag)
+{
+    return Z_TagMallocZone(mainzone, size, tag);
+}
+
+void *Z_TagMallocZone(memzone_t * zone, int size, int tag)
 {
     int extra;
     memblock_t *start, *rover, *new, *base;
@@ -164,7 +193,7 @@ void *Z_TagMalloc(int size, int tag)
     size += 4;                  // space for memory trash tester
     size = (size + 7) & ~7;     // align to 8-byte boundary
 
-    base = rover = mainzone->rover;
+    base = rover = zone->rover;
     start = base->prev;
 
     do {
@@ -194,7 +223,7 @@ void *Z_TagMalloc(int size, int tag)
 
     base->tag = tag;            // no longer a free block
 
-    mainzone->rover = base->next;       // next allocation will start looking here
+    zone->rover = base->next;   // next allocation will start looking here
 
     base->id = ZONEID;
 
@@ -85,10 +85,17 @@ Zone block
 
 void Memory_Init(void *buf, int size);
 
+typedef struct memzone_s memzone_t;
+
 void Z_Free(void *ptr);
 void *Z_Malloc(int size);       // returns 0 filled memory
 void *Z_TagMalloc(int size, int tag);
 
+memzone_t *Z_NewZone(int size, char *name);
+void Z_FreeZone(memzone_t * zone, void *ptr);
+void *Z_TagMallocZone(memzone_t * zone, int size, int tag);
+// like Z_TagMalloc, returns NULL when the zone is full
+
 void Z_DumpHeap(void);
 void Z_CheckHeap(void);
 int Z_FreeMemory(void);